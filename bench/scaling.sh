@@ -0,0 +1,66 @@
+#!/bin/bash
+# ----------------------------------------------------------------------
+# Strong and weak scaling benchmarks of laplace_1D, laplace_2D and laplace_3D
+#
+# Each run computes a fixed number of iterations (--max-iter, the tolerance cannot be reached), with warm-up and measured trials,
+# and appends its measures to the report (--report, see src/bench.h) : a CSV or JSON Lines file that can be kept between releases.
+#     strong : the same matrix dimensions N on all the processor counts
+#     weak   : N is the dimension on 1 processor, scaled by NPROC^(1/2) (NPROC^(1/3) for laplace_3D) to keep the values per processor
+#
+# Usage: bench/scaling.sh [-s strong|weak] [-p "PROCS"] [-n "SIZES"] [-i ITER] [-w WARMUP] [-r REPEAT]
+#                         [-o REPORT] [-f csv|json] [-l LAUNCHER] PROGRAM [solver options]
+# Example:
+# $ bench/scaling.sh -s strong -p "1 2 4 8" -n "1000 2000 4000" -o scaling.csv src/laplace_2D --method sor
+# $ bench/scaling.sh -s weak -p "1 8 27 64" -n "100" -f json -o weak.json src/laplace_3D
+# ----------------------------------------------------------------------
+
+mode=strong
+procs="1 2 4"
+sizes="1000"
+iterations=100
+warmup=1
+repeat=5
+report=scaling.csv
+format=csv
+launcher="mpirun"
+
+while getopts "s:p:n:i:w:r:o:f:l:h" option; do
+    case $option in
+        s) mode=$OPTARG ;;
+        p) procs=$OPTARG ;;
+        n) sizes=$OPTARG ;;
+        i) iterations=$OPTARG ;;
+        w) warmup=$OPTARG ;;
+        r) repeat=$OPTARG ;;
+        o) report=$OPTARG ;;
+        f) format=$OPTARG ;;
+        l) launcher=$OPTARG ;;
+        *) sed -n '2,15p' "$0"; exit 1 ;;
+    esac
+done
+shift $((OPTIND-1))
+if [ $# -lt 1 ] || { [ "$mode" != strong ] && [ "$mode" != weak ]; }; then
+    sed -n '2,15p' "$0"
+    exit 1
+fi
+program=$1
+shift
+
+ndims=2
+case $(basename "$program") in
+    *3D*) ndims=3 ;;
+esac
+
+for N in $sizes; do
+    for np in $procs; do
+        size=$N
+        if [ "$mode" = weak ]; then
+            size=$(awk -v n="$N" -v p="$np" -v d="$ndims" 'BEGIN { printf "%d", n*p^(1/d) + 0.5 }')
+        fi
+        echo "$mode scaling: $np processors, N = $size"
+        $launcher -np "$np" "$program" --verbosity 0 --tolerance 1e-30 --max-iter "$iterations" \
+            --warmup "$warmup" --repeat "$repeat" --report "$report" --report-format "$format" "$@" "$size" | grep "^Benchmark" \
+            || { echo "ERROR: the run on $np processors failed"; exit 1; }
+    done
+done
+echo "Report: $report"
@@ -0,0 +1,249 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Placement of the matrices in memory (alignment, first touch) and of the processors and threads on the cores
+
+----------------------------------------------------------------------
+*/
+
+
+#define _GNU_SOURCE // sched_getaffinity, sched_getcpu
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "affinity.h"
+#include "stencil.h"
+
+
+#define CACHE_LINE 64                   // alignment of the matrices
+#define HUGE_PAGE (2*1024*1024)         // alignment of the matrices with set_huge_pages
+#define AFFINITY_MAX_CPUS 1024          // cores described by the report
+#define AFFINITY_MAX_THREADS 64         // threads described by the report, per processor
+#define AFFINITY_MAX_NUMA_NODES 1024    // NUMA nodes searched in /sys for a core
+
+
+static int huge_pages = 0;
+
+
+void set_huge_pages(int enabled)
+{
+    huge_pages = enabled;
+}
+
+
+real *alloc_matrix(int nb_rows, int nb_cols)
+{
+    size_t size = (size_t)nb_rows*nb_cols*sizeof(real);
+    size_t alignment = CACHE_LINE;
+    if (huge_pages && size >= HUGE_PAGE)
+    {
+        alignment = HUGE_PAGE;
+        size = (size + HUGE_PAGE-1) / HUGE_PAGE * HUGE_PAGE; // whole huge pages
+    }
+    void *memory = NULL;
+    if (posix_memalign(&memory, alignment, size > 0 ? size : alignment) != 0) { return NULL; }
+#ifdef MADV_HUGEPAGE
+    if (alignment == HUGE_PAGE) { madvise(memory, size, MADV_HUGEPAGE); } // a hint : ignored without transparent huge pages
+#endif
+
+    // First touch : the pages are placed by the static schedule of the stencil kernels (same threshold, same rows per thread)
+    real *matrix = (real*)memory;
+    #pragma omp parallel for schedule(static) if((long)nb_rows*nb_cols >= STENCIL_MIN_PARALLEL_CELLS)
+    for (int i = 0; i < nb_rows; i++)
+    {
+        memset(matrix + (size_t)i*nb_cols, 0, nb_cols*sizeof(real));
+    }
+    return matrix;
+}
+
+
+void copy_matrix(real *dst, const real *src, int nb_rows, int nb_cols)
+{
+    #pragma omp parallel for schedule(static) if((long)nb_rows*nb_cols >= STENCIL_MIN_PARALLEL_CELLS)
+    for (int i = 0; i < nb_rows; i++)
+    {
+        memcpy(dst + (size_t)i*nb_cols, src + (size_t)i*nb_cols, nb_cols*sizeof(real));
+    }
+}
+
+
+/**
+ * Placement of a processor, gathered by the processor 0 (a cpu or a node is -1 when it is unknown)
+ */
+typedef struct
+{
+    char node[MPI_MAX_PROCESSOR_NAME];          // name of the compute node
+    int online_cpus;                            // cores of the compute node
+    int nb_cpus;                                // cores allowed to the processor (-1 : unknown)
+    unsigned char mask[AFFINITY_MAX_CPUS/8];    // allowed cores, a bit per core
+    int nb_threads;                             // OpenMP threads
+    int thread_cpus[AFFINITY_MAX_THREADS];      // core of each thread
+    int thread_numa[AFFINITY_MAX_THREADS];      // NUMA node of this core
+} placement;
+
+
+/**
+ * NUMA node of a core, read in /sys (-1 : unknown)
+ */
+static int cpu_numa_node(int cpu)
+{
+    char path[128];
+    for (int node = 0; cpu >= 0 && node < AFFINITY_MAX_NUMA_NODES; node++)
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) { return node; }
+    }
+    return -1;
+}
+
+
+/**
+ * Core of the calling thread (-1 : unknown)
+ */
+static int current_cpu(void)
+{
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+
+/**
+ * My placement : allowed cores, and core of each thread at the time of the call
+ */
+static void get_placement(placement *mine)
+{
+    memset(mine, 0, sizeof(placement));
+    int length;
+    MPI_Get_processor_name(mine->node, &length);
+    mine->online_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    mine->nb_cpus = -1;
+    mine->nb_threads = 1;
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        mine->nb_cpus = CPU_COUNT(&set);
+        for (int cpu = 0; cpu < AFFINITY_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set)) { mine->mask[cpu/8] |= 1 << (cpu%8); }
+        }
+    }
+#endif
+#ifdef _OPENMP
+    mine->nb_threads = omp_get_max_threads();
+    #pragma omp parallel
+    {
+        int thread = omp_get_thread_num();
+        if (thread < AFFINITY_MAX_THREADS) { mine->thread_cpus[thread] = current_cpu(); }
+    }
+#else
+    mine->thread_cpus[0] = current_cpu();
+#endif
+    for (int thread = 0; thread < mine->nb_threads && thread < AFFINITY_MAX_THREADS; thread++)
+    {
+        mine->thread_numa[thread] = cpu_numa_node(mine->thread_cpus[thread]);
+    }
+}
+
+
+/**
+ * Write the allowed cores of a placement as ranges ("0-3,8") in text
+ */
+static void format_cpus(const placement *p, char *text, int size)
+{
+    int length = 0;
+    text[0] = '\0';
+    for (int cpu = 0; cpu < AFFINITY_MAX_CPUS && length < size; cpu++)
+    {
+        if (!(p->mask[cpu/8] & (1 << (cpu%8)))) { continue; }
+        int last = cpu;
+        while (last+1 < AFFINITY_MAX_CPUS && (p->mask[(last+1)/8] & (1 << ((last+1)%8)))) { last++; }
+        if (last > cpu) { length += snprintf(text + length, size - length, "%s%d-%d", length > 0 ? "," : "", cpu, last); }
+        else            { length += snprintf(text + length, size - length, "%s%d", length > 0 ? "," : "", cpu); }
+        cpu = last;
+    }
+    if (length == 0) { snprintf(text, size, "unknown"); }
+}
+
+
+/**
+ * Returns 1 if the placements a and b have a core in common
+ */
+static int share_cpus(const placement *a, const placement *b)
+{
+    for (int k = 0; k < AFFINITY_MAX_CPUS/8; k++)
+    {
+        if (a->mask[k] & b->mask[k]) { return 1; }
+    }
+    return 0;
+}
+
+
+void print_affinity(MPI_Comm comm)
+{
+    int me, NPROC;
+    MPI_Comm_rank(comm, &me);
+    MPI_Comm_size(comm, &NPROC);
+    placement mine;
+    get_placement(&mine);
+    placement *all = NULL;
+    if (me == 0)
+    {
+        all = (placement*)malloc(NPROC*sizeof(placement));
+        if (all == NULL) { exit(-1); } // Check if the memory has been well allocated
+    }
+    MPI_Gather(&mine, sizeof(placement), MPI_BYTE, all, sizeof(placement), MPI_BYTE, 0, comm);
+    if (me != 0) { return; }
+
+    char cpus[256];
+    for (int i = 0; i < NPROC; i++)
+    {
+        const placement *p = &all[i];
+        format_cpus(p, cpus, sizeof(cpus));
+        printf("Affinity: processor %d on %s : cores %s (%d of %d), threads :", i, p->node, cpus, p->nb_cpus, p->online_cpus);
+        for (int thread = 0; thread < p->nb_threads && thread < AFFINITY_MAX_THREADS; thread++)
+        {
+            printf(" %d->core %d (NUMA %d)", thread, p->thread_cpus[thread], p->thread_numa[thread]);
+        }
+        printf("\n");
+    }
+
+    // Binding check : the processors of a node should be bound to distinct cores, with a core per thread
+    for (int i = 0; i < NPROC; i++)
+    {
+        const placement *p = &all[i];
+        if (p->nb_cpus < 0) { continue; } // unknown
+        if (p->nb_threads > p->nb_cpus)
+        {
+            printf("WARNING: processor %d has %d threads for %d cores\n", i, p->nb_threads, p->nb_cpus);
+        }
+        int on_node = 0, shared_with = -1;
+        for (int j = 0; j < NPROC; j++)
+        {
+            if (strcmp(all[j].node, p->node) != 0) { continue; }
+            on_node++;
+            if (j > i && shared_with < 0 && share_cpus(p, &all[j])) { shared_with = j; }
+        }
+        if (on_node > 1 && p->nb_cpus == p->online_cpus)
+        {
+            printf("WARNING: processor %d is not bound : it may run on all the cores of %s, with %d processors (mpirun --bind-to)\n", i, p->node, on_node);
+        }
+        else if (shared_with >= 0)
+        {
+            printf("WARNING: processors %d and %d share cores of %s\n", i, shared_with, p->node);
+        }
+    }
+    free(all);
+}
@@ -0,0 +1,50 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Placement of the matrices in memory and of the processors and threads on the cores, shared by all the programs
+
+The matrices are aligned on a cache line (64 bytes, or a huge page with set_huge_pages) and their pages are first
+touched by the OpenMP threads which compute them : the rows are set to 0 with the static schedule of the stencil kernels,
+so that on a NUMA node each page is placed in the memory of the socket of the thread which sweeps it.
+
+----------------------------------------------------------------------
+*/
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include "mpi.h"
+#include "precision.h"
+
+
+/**
+ * 1 : the matrices of at least a huge page (2 MB) are aligned on a huge page, and the kernel is asked to back them
+ * with transparent huge pages (madvise). 0 (default) : the matrices are aligned on a cache line.
+ */
+void set_huge_pages(int enabled);
+
+
+/**
+ * Allocate a matrix of nb_rows x nb_cols values set to 0 : the rows are first touched by the OpenMP threads
+ * that compute them in the stencil kernels. The matrix is released by free(). Returns NULL if the memory cannot be allocated.
+ * A 3D matrix is given as nb_planes*nb_rows rows of nb_cols values.
+ */
+real *alloc_matrix(int nb_rows, int nb_cols);
+
+
+/**
+ * Copy the matrix src of nb_rows x nb_cols values in dst, each row by the thread that computes it
+ */
+void copy_matrix(real *dst, const real *src, int nb_rows, int nb_cols);
+
+
+/**
+ * Print the placement of the processors of comm and their OpenMP threads (processor 0, collective on comm) :
+ * node, allowed cores, core and NUMA node of each thread, and a warning when the processors of a node are not bound
+ * to it, share cores, or have more threads than allowed cores.
+ */
+void print_affinity(MPI_Comm comm);
+
+
+#endif
@@ -0,0 +1,137 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Dynamic load balancing of laplace_1D and laplace_2D : measure of the compute time, new limits of the blocks
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "balance.h"
+#include "timers.h"
+
+
+#define BALANCE_THRESHOLD 1.05  // the blocks move when the slowest processor computes 5% more than the average
+#define BALANCE_DAMPING 0.5     // part of the way to the balanced limits done by a move (the measures are noisy)
+
+
+void init_load_balancer(load_balancer *balancer)
+{
+    balancer->last_compute = timer_get(TIMER_COMPUTE);
+    balancer->nb_moves = 0;
+}
+
+
+/**
+ * New limits new_splits of nb_parts rows (or columns) of processors, whose limits are splits and whose slowest processors
+ * computed for times seconds : halfway to the sizes proportional to the speeds, at least one row (or column) per part.
+ * Returns 1 if a limit has moved.
+ */
+static int balanced_splits(int nb_parts, const double *times, const int *splits, int *new_splits)
+{
+    int N = splits[nb_parts];
+    double total_speed = 0;
+    for (int part = 0; part < nb_parts; part++)
+    {
+        total_speed += (splits[part+1] - splits[part]) / times[part];
+    }
+
+    int moved = 0;
+    double speed = 0; // speed of the parts before the limit
+    new_splits[0] = 0;
+    new_splits[nb_parts] = N;
+    for (int part = 1; part < nb_parts; part++)
+    {
+        speed += (splits[part] - splits[part-1]) / times[part-1];
+        double target = N*speed/total_speed;
+        int limit = splits[part] + (int)((target - splits[part])*BALANCE_DAMPING);
+        if (limit < new_splits[part-1]+1) { limit = new_splits[part-1]+1; } // a row at least in each part
+        if (limit > N-(nb_parts-part))    { limit = N-(nb_parts-part); }
+        new_splits[part] = limit;
+        moved |= (limit != splits[part]);
+    }
+    return moved;
+}
+
+
+int balance_load(load_balancer *balancer, processor_grid *grid, real **local_tab, int iteration, int verbosity)
+{
+    int NPROC = grid->NPROC, me = grid->me;
+    const int *dims = grid->dims;
+    double compute = timer_get(TIMER_COMPUTE);
+    double my_time = compute - balancer->last_compute;
+    balancer->last_compute = compute;
+
+    // Processor 0 : times of the processors, and new limits [moved, row_splits, col_splits] for all
+    int nb_values = 1 + dims[0]+1 + dims[1]+1;
+    int *decision = (int*)malloc(nb_values*sizeof(int));
+    double *times = (me == 0) ? (double*)malloc((NPROC + dims[0] + dims[1])*sizeof(double)) : NULL;
+    if (decision == NULL || (me == 0 && times == NULL)) { exit(-1); } // Check if the memory has been well allocated
+    MPI_Gather(&my_time, 1, MPI_DOUBLE, times, 1, MPI_DOUBLE, 0, grid->comm);
+    double imbalance = 1;
+    if (me == 0)
+    {
+        double *row_times = times + NPROC, *col_times = row_times + dims[0]; // time of the slowest processor of each row and column
+        double max_time = 0, sum_time = 0;
+        for (int k = 0; k < dims[0] + dims[1]; k++)
+        {
+            row_times[k] = 0;
+        }
+        for (int i = 0; i < NPROC; i++)
+        {
+            double time = times[i];
+            if (time > row_times[i/dims[1]]) { row_times[i/dims[1]] = time; }
+            if (time > col_times[i%dims[1]]) { col_times[i%dims[1]] = time; }
+            if (time > max_time) { max_time = time; }
+            sum_time += time;
+        }
+        int measured = 1; // no time is 0 : the blocks are not moved after a window without sweeps
+        for (int k = 0; k < dims[0] + dims[1]; k++)
+        {
+            measured &= (row_times[k] > 0);
+        }
+        imbalance = (sum_time > 0) ? max_time*NPROC/sum_time : 1;
+        decision[0] = 0;
+        if (measured && imbalance > BALANCE_THRESHOLD)
+        {
+            decision[0] |= balanced_splits(dims[0], row_times, grid->row_splits, decision + 1);
+            decision[0] |= balanced_splits(dims[1], col_times, grid->col_splits, decision + 1 + dims[0]+1);
+        }
+    }
+    MPI_Bcast(decision, nb_values, MPI_INT, 0, grid->comm);
+    int moved = decision[0];
+    if (moved)
+    {
+        timer_phase previous = timer_switch(TIMER_COPY);
+        repartition_grid(grid, decision + 1, decision + 1 + dims[0]+1, local_tab);
+        timer_switch(previous);
+        balancer->nb_moves++;
+    }
+
+    if (moved && me == 0 && verbosity >= 1)
+    {
+        int min_rows = grid->row_splits[1] - grid->row_splits[0], max_rows = min_rows;
+        int min_cols = grid->col_splits[1] - grid->col_splits[0], max_cols = min_cols;
+        for (int k = 1; k < dims[0]; k++)
+        {
+            int rows = grid->row_splits[k+1] - grid->row_splits[k];
+            if (rows < min_rows) { min_rows = rows; }
+            if (rows > max_rows) { max_rows = rows; }
+        }
+        for (int k = 1; k < dims[1]; k++)
+        {
+            int cols = grid->col_splits[k+1] - grid->col_splits[k];
+            if (cols < min_cols) { min_cols = cols; }
+            if (cols > max_cols) { max_cols = cols; }
+        }
+        printf("Load balance after %d iterations : compute time imbalance %.2f (max/average), new blocks of %d to %d rows and %d to %d columns\n",
+               iteration, imbalance, min_rows, max_rows, min_cols, max_cols);
+    }
+    free(decision);
+    free(times);
+    return moved;
+}
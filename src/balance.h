@@ -0,0 +1,48 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Dynamic load balancing of laplace_1D and laplace_2D (--balance-every) : the limits of the blocks follow the speed of the processors
+
+Every balance_every iterations, the processor 0 gathers the compute time of each processor since the previous measure
+(TIMER_COMPUTE of timers.h : the sweeps, without the waits for the neighbors and the reductions, which only show the imbalance).
+The time of a row (column) of processors is the one of its slowest processor, and its speed is its number of rows (columns)
+per second. When the slowest processor computes more than BALANCE_THRESHOLD times the average, the limits of the rows and of
+the columns of processors move halfway to the sizes proportional to these speeds (at least a row and a column per block),
+and repartition_grid moves the values between the neighbors. The next measures correct the remaining imbalance,
+and follow the changes of speed of the nodes.
+
+----------------------------------------------------------------------
+*/
+
+#ifndef BALANCE_H
+#define BALANCE_H
+
+#include "precision.h"
+#include "grid.h"
+
+
+/**
+ * State of the load balancing between two measures
+ */
+typedef struct
+{
+    double last_compute;    // TIMER_COMPUTE at the previous measure
+    int nb_moves;           // number of repartitions of the blocks
+} load_balancer;
+
+
+/**
+ * Start the measures of the load balancing, from the current compute time
+ */
+void init_load_balancer(load_balancer *balancer);
+
+/**
+ * Measure the compute time of the processors since the previous measure and move the limits of the blocks if they are
+ * not balanced (collective). The processor 0 prints the new blocks after iteration iterations if verbosity >= 1.
+ * Returns 1 if the blocks have moved : *local_tab is then a new local matrix (repartition_grid), 0 otherwise.
+ */
+int balance_load(load_balancer *balancer, processor_grid *grid, real **local_tab, int iteration, int verbosity);
+
+
+#endif
@@ -0,0 +1,292 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Batch mode : problems with different boundary values solved together on interleaved local matrices
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "batch.h"
+#include "driver.h"
+#include "solver.h"
+#include "stencil.h"
+#include "timers.h"
+#include "affinity.h"
+#include "io.h"
+#include "output.h"
+#include "guess.h"
+
+
+#define BATCH_LINE 1024 // longest line of a batch file
+
+
+/**
+ * Read the boundary values (bottom, top, left, right) of the problems of the batch file filename on the processor 0,
+ * and give them to all the processors of comm in *boundaries (4 values per problem, released by free).
+ * Returns the number of problems, or -1 if the file cannot be read (the processor 0 prints the error)
+ */
+static int read_batch(const char *filename, MPI_Comm comm, int me, double **boundaries)
+{
+    int nb_problems = 0;
+    double *values = NULL;
+    if (me == 0)
+    {
+        FILE *f = fopen(filename, "r");
+        if (f == NULL)
+        {
+            printf("ERROR: batch: cannot open %s\n", filename);
+            nb_problems = -1;
+        }
+        char line[BATCH_LINE];
+        int capacity = 0, line_number = 0;
+        while (f != NULL && nb_problems >= 0 && fgets(line, sizeof(line), f) != NULL)
+        {
+            line_number++;
+            line[strcspn(line, "#")] = '\0'; // a comment runs to the end of the line
+            char *text = line + strspn(line, " \t\r\n");
+            if (*text == '\0') { continue; } // empty line or comment only
+
+            double edges[4];
+            char extra;
+            if (sscanf(text, "%lf %lf %lf %lf %c", &edges[0], &edges[1], &edges[2], &edges[3], &extra) != 4)
+            {
+                printf("ERROR: batch: line %d of %s should give 4 boundary values (bottom top left right)\n", line_number, filename);
+                nb_problems = -1;
+                break;
+            }
+            if (nb_problems == capacity)
+            {
+                capacity = (capacity == 0) ? 16 : 2*capacity;
+                values = (double*)realloc(values, 4*capacity*sizeof(double));
+                if (values == NULL) { exit(-1); } // Check if the memory has been well allocated
+            }
+            memcpy(values + 4*nb_problems, edges, sizeof(edges));
+            nb_problems++;
+        }
+        if (f != NULL) { fclose(f); }
+        if (nb_problems == 0)
+        {
+            printf("ERROR: batch: %s gives no problem\n", filename);
+            nb_problems = -1;
+        }
+    }
+
+    MPI_Bcast(&nb_problems, 1, MPI_INT, 0, comm);
+    if (nb_problems < 0)
+    {
+        free(values);
+        return -1;
+    }
+    if (me != 0 && (values = (double*)malloc(4*nb_problems*sizeof(double))) == NULL) { exit(-1); } // Check if the memory has been well allocated
+    MPI_Bcast(values, 4*nb_problems, MPI_DOUBLE, 0, comm);
+    *boundaries = values;
+    return nb_problems;
+}
+
+
+/**
+ * Write the local matrix of a problem in its result file, as laplace_main() for a single problem (collective)
+ */
+static void save_problem(const processor_grid *grid, const solver_options *options, const char *filename, const real *local_tab)
+{
+    if (options->verbosity >= 1 && options->format == OUTPUT_TEXT)
+    {
+        print_and_save_final_matrix(filename, grid, local_tab, options->verbosity);
+    }
+    else if (options->verbosity >= 1)
+    {
+        write_output(filename, grid->comm, local_tab, &grid->layout, options);
+    }
+}
+
+
+/**
+ * Copy the values of the slot from of the interleaved matrix src (nb_src problems per cell) to the slot to of dst (nb_dst problems),
+ * for all the nb_cells cells (adjacent values included). nb_src = 1 or nb_dst = 1 : a single local matrix.
+ */
+static void copy_problem(real *dst, int to, int nb_dst, const real *src, int from, int nb_src, long nb_cells)
+{
+    for (long cell = 0; cell < nb_cells; cell++)
+    {
+        dst[cell*nb_dst + to] = src[cell*nb_src + from];
+    }
+}
+
+
+/**
+ * Problems left in the batch : the slots whose problem is not finished (keep) are moved to the first ones, in new buffers
+ * with nb_left values per cell, which replace tabs[0..nb_tabs-1]
+ */
+static void compact_batch(real *tabs[2], int nb_tabs, int nb_rows, int nb_cols, int nb_active, const int *keep, int nb_left)
+{
+    long nb_cells = (long)nb_rows*nb_cols;
+    for (int t = 0; t < nb_tabs; t++)
+    {
+        real *compacted = alloc_matrix(nb_rows, nb_cols*nb_left);
+        if (compacted == NULL) { exit(-1); } // Check if the memory has been well allocated
+        for (int slot = 0, left = 0; slot < nb_active; slot++)
+        {
+            if (keep[slot]) { copy_problem(compacted, left++, nb_left, tabs[t], slot, nb_active, nb_cells); }
+        }
+        free(tabs[t]);
+        tabs[t] = compacted;
+    }
+}
+
+
+int laplace_batch(processor_grid *grid, const solver_options *options, const char *name)
+{
+    int me = grid->me;
+    double *boundaries;
+    int nb_problems = read_batch(options->batch, grid->comm, me, &boundaries);
+    if (nb_problems < 0) { return -1; }
+    if (me == 0 && options->verbosity >= 1) { printf("Batch: %d problems from %s\n", nb_problems, options->batch); }
+
+    int nb_rows = grid->Nlocal_rows, nb_cols = grid->Nlocal_cols;
+    long nb_cells = (long)nb_rows*nb_cols;
+    int is_jacobi = (options->method == METHOD_JACOBI);
+    int *problems = (int*)malloc(nb_problems*sizeof(int));  // problem of each slot of the interleaved matrices
+    int *keep = (int*)malloc(nb_problems*sizeof(int));      // slots still in the batch after a check
+    double *errors = (double*)malloc(nb_problems*sizeof(double)); // squared differences of the problem of each slot
+    real *single = alloc_matrix(nb_rows, nb_cols);          // a problem alone : initialization and result files
+    real *tabs[2] = {alloc_matrix(nb_rows, nb_cols*nb_problems), is_jacobi ? alloc_matrix(nb_rows, nb_cols*nb_problems) : NULL}; // current, next (jacobi)
+    if (problems == NULL || keep == NULL || errors == NULL || single == NULL || tabs[0] == NULL || (is_jacobi && tabs[1] == NULL)) { exit(-1); } // Check if the memory has been well allocated
+
+    // Initial values of each problem (boundary values of its line), as initialize_local_matrix() and set_initial_guess() for a single problem
+    solver_options problem_options = *options;
+    for (int b = 0; b < nb_problems; b++)
+    {
+        for (int edge = 0; edge < 4; edge++)
+        {
+            problem_options.boundary[edge] = boundaries[4*b + edge];
+        }
+        initialize_local_matrix(grid, single, &problem_options);
+        if (set_initial_guess(grid, single, &problem_options) != 0)
+        {
+            free(problems);
+            free(keep);
+            free(errors);
+            free(single);
+            free(tabs[0]);
+            free(tabs[1]);
+            free(boundaries);
+            return -1;
+        }
+        copy_problem(tabs[0], b, nb_problems, single, 0, 1, nb_cells);
+        problems[b] = b;
+        errors[b] = +INFINITY;
+    }
+    if (is_jacobi) { copy_matrix(tabs[1], tabs[0], nb_rows, nb_cols*nb_problems); } // same adjacent values
+    free(boundaries);
+
+    halo_exchange halo; // a message per neighbor for all the problems of the batch
+    init_batch_halo_exchange(&halo, grid->comm, nb_rows, nb_cols, nb_problems);
+    update_matrix(&halo, tabs[0]);
+    stencil_region parts[5]; // inner block and outer ring, computed before and after the arrival of the adjacent data
+    split_block(1, nb_rows-2, 1, nb_cols-2, grid->has_neighbor, parts);
+
+    char default_output[256], filename[512];
+    const char *output = output_filename(options, name, default_output, sizeof(default_output));
+    int nb_active = nb_problems, iter_count = 0;
+    timer_switch(TIMER_COMPUTE);
+    while (nb_active > 0 && (options->max_iter == 0 || iter_count < options->max_iter))
+    {
+        iter_count++;
+        int with_error = (iter_count % options->check_every == 0);
+        if (with_error) { memset(errors, 0, nb_active*sizeof(double)); }
+
+        if (is_jacobi)
+        {
+            start_update_matrix(&halo, tabs[0]); // refresh the adjacent data in the background
+            stencil_sweep_batch(tabs[0], tabs[1], parts[0].first_row, parts[0].last_row, parts[0].first_col, parts[0].last_col, nb_cols, nb_active, with_error, errors);
+            wait_update_matrix(&halo);
+            for (int p = 1; p < 5; p++) // outer ring of the significant values
+            {
+                stencil_sweep_batch(tabs[0], tabs[1], parts[p].first_row, parts[p].last_row, parts[p].first_col, parts[p].last_col, nb_cols, nb_active, with_error, errors);
+            }
+            real *swap = tabs[0]; // the new values become the current ones (no copy)
+            tabs[0] = tabs[1];
+            tabs[1] = swap;
+        }
+        else
+        {
+            for (int color = 0; color < 2; color++) // red cells, then black cells
+            {
+                int parity = (color + grid->layout.starts[0] + grid->layout.starts[1]) & 1; // as laplace()
+                start_update_matrix(&halo, tabs[0]);
+                stencil_relax_color_batch(tabs[0], parts[0].first_row, parts[0].last_row, parts[0].first_col, parts[0].last_col, nb_cols, nb_active, parity, options->omega, with_error, errors);
+                wait_update_matrix(&halo);
+                for (int p = 1; p < 5; p++)
+                {
+                    stencil_relax_color_batch(tabs[0], parts[p].first_row, parts[p].last_row, parts[p].first_col, parts[p].last_col, nb_cols, nb_active, parity, options->omega, with_error, errors);
+                }
+            }
+        }
+        if (!with_error) { continue; }
+
+        timer_switch(TIMER_REDUCTION);
+        MPI_Allreduce(MPI_IN_PLACE, errors, nb_active, MPI_DOUBLE, MPI_SUM, grid->comm); // the errors of all the problems at once
+        timer_switch(TIMER_OTHER);
+
+        // The converged problems leave the batch : their result files are written, the others move to the first slots
+        int nb_left = 0;
+        double max_error = 0;
+        for (int slot = 0; slot < nb_active; slot++)
+        {
+            double error = sqrt(errors[slot]);
+            keep[slot] = (error >= options->tolerance);
+            if (keep[slot])
+            {
+                if (error > max_error) { max_error = error; }
+                errors[nb_left] = errors[slot];
+                problems[nb_left++] = problems[slot];
+                continue;
+            }
+            if (me == 0 && options->verbosity >= 1) { printf("Problem %d converged after %d iterations - error = %e\n", problems[slot], iter_count, error); }
+            copy_problem(single, 0, 1, tabs[0], slot, nb_active, nb_cells);
+            indexed_filename(output, problems[slot], filename, sizeof(filename));
+            save_problem(grid, options, filename, single);
+        }
+        if (me == 0 && options->verbosity >= 1 && iter_count % options->log_every == 0 && nb_left > 0)
+        {
+            printf("Iteration %d - %d problems left - max error = %e\n", iter_count, nb_left, max_error);
+        }
+        if (nb_left < nb_active && nb_left > 0)
+        {
+            compact_batch(tabs, is_jacobi ? 2 : 1, nb_rows, nb_cols, nb_active, keep, nb_left);
+            free_halo_exchange(&halo);
+            init_batch_halo_exchange(&halo, grid->comm, nb_rows, nb_cols, nb_left);
+        }
+        nb_active = nb_left;
+        timer_switch(TIMER_COMPUTE);
+    }
+
+    // Maximum number of iterations : the problems left are saved with their last error
+    timer_switch(TIMER_OTHER);
+    for (int slot = 0; slot < nb_active; slot++)
+    {
+        if (me == 0 && options->verbosity >= 1)
+        {
+            printf("WARNING: problem %d : maximum number of iterations reached (%d), the error is still %e\n", problems[slot], iter_count, sqrt(errors[slot]));
+        }
+        copy_problem(single, 0, 1, tabs[0], slot, nb_active, nb_cells);
+        indexed_filename(output, problems[slot], filename, sizeof(filename));
+        save_problem(grid, options, filename, single);
+    }
+    if (me == 0 && options->verbosity >= 1) { printf("Batch: %d problems, %d iterations\n", nb_problems, iter_count); }
+
+    free_halo_exchange(&halo);
+    free(tabs[0]);
+    free(tabs[1]);
+    free(single);
+    free(errors);
+    free(keep);
+    free(problems);
+    return iter_count;
+}
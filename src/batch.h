@@ -0,0 +1,35 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Batch mode of laplace_1D and laplace_2D (--batch FILE) : many problems on the same grid, solved together
+
+The batch file gives a problem per line, its boundary values : bottom top left right (as --bottom, --top, --left, --right),
+a # starts a comment, to the end of the line, and the empty lines are skipped. All the problems have the same initial guess, method and tolerance.
+The local matrices of the problems are interleaved : the values of a cell for all the problems are contiguous, so a sweep
+updates all the problems at once (stencil_sweep_batch), and a single message per neighbor carries the adjacent rows (columns)
+of all the problems (init_batch_halo_exchange) : the latency of the messages and of the reduction of the errors (one per check,
+for all the problems) is shared by the batch. Each problem has its own error : once it is lower than the tolerance, the problem
+leaves the batch (the next sweeps and messages are smaller) and its result file is written. The file of the problem b
+(0 for the first line) is the result file name with _b before its extension (result_laplace_2D_3.txt).
+
+----------------------------------------------------------------------
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "options.h"
+#include "grid.h"
+
+
+/**
+ * Solve the problems of the batch file options->batch on the decomposition grid (collective), from the initial guess,
+ * and write their result files (options->verbosity >= 1, as the result file of a single problem of the program name).
+ * Returns the number of iterations computed (the ones of the last problem of the batch), or -1 if the batch file
+ * or the file of --initial-file cannot be read (the processor 0 prints the error).
+ */
+int laplace_batch(processor_grid *grid, const solver_options *options, const char *name);
+
+
+#endif
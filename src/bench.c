@@ -0,0 +1,293 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Benchmark mode : warm-up and measured trials of the computation, report of the measures (CSV or JSON Lines)
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+#include "stencil.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/**
+ * Name of the method in the reports, as on the command line
+ */
+static const char *method_name(solver_method method)
+{
+    switch (method)
+    {
+        case METHOD_JACOBI:       return "jacobi";
+        case METHOD_GAUSS_SEIDEL: return "gauss-seidel";
+        case METHOD_SOR:          return "sor";
+        case METHOD_MULTIGRID:    return "multigrid";
+        default:                  return "cg";
+    }
+}
+
+
+/**
+ * Minimum number of bytes moved by a lattice update of the method (0 : no model, see bench.h)
+ */
+static double bytes_per_update(solver_method method)
+{
+    if (method == METHOD_JACOBI) { return 2*sizeof(real); }
+    if (method == METHOD_GAUSS_SEIDEL || method == METHOD_SOR) { return 4*sizeof(real); }
+    return 0;
+}
+
+
+/**
+ * Comparison of two times, for qsort
+ */
+static int compare_times(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+
+void init_benchmark(benchmark *bench, int warmup, int trials)
+{
+    bench->warmup = warmup;
+    bench->trials = trials;
+    bench->nb_done = 0;
+    bench->times = (double*)malloc(trials*sizeof(double));
+    if (bench->times == NULL) { exit(-1); } // Check if the memory has been well allocated
+    for (int phase = 0; phase < NB_TIMERS; phase++)
+    {
+        bench->phase_times[phase] = 0;
+    }
+    bench->iterations = 0;
+}
+
+
+void start_trial(benchmark *bench, MPI_Comm comm)
+{
+    MPI_Barrier(comm); // the trial starts at the same time on all the processors
+    timers_reset();
+    bench->trial_start = MPI_Wtime();
+}
+
+
+void end_trial(benchmark *bench, MPI_Comm comm, int iterations)
+{
+    double local_time = MPI_Wtime() - bench->trial_start, time;
+    timer_switch(TIMER_OTHER); // closes the last phase
+    MPI_Allreduce(&local_time, &time, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    int measured = bench->nb_done - bench->warmup; // index of the measured trial, < 0 for a warm-up trial
+    if (measured >= 0)
+    {
+        bench->times[measured] = time;
+        for (int phase = 0; phase < NB_TIMERS; phase++)
+        {
+            bench->phase_times[phase] += timer_get(phase);
+        }
+    }
+    bench->iterations = iterations;
+    bench->nb_done++;
+}
+
+
+/**
+ * Time per iteration of a phase over the processors
+ */
+typedef struct
+{
+    double avg, min, max;   // average, minimum and maximum over the processors
+    int max_rank;           // processor of the maximum
+} phase_stats;
+
+
+/**
+ * Reduce my times of the phases on the processor 0 (collective on comm) : per iteration of the measured trials
+ */
+static void reduce_phases(const benchmark *bench, MPI_Comm comm, phase_stats stats[NB_TIMERS])
+{
+    int me, NPROC;
+    MPI_Comm_rank(comm, &me);
+    MPI_Comm_size(comm, &NPROC);
+    double per_iteration = 1.0/((double)bench->trials*(bench->iterations > 0 ? bench->iterations : 1));
+    double mine[NB_TIMERS], sums[NB_TIMERS], mins[NB_TIMERS];
+    struct { double value; int rank; } local_max[NB_TIMERS], global_max[NB_TIMERS];
+    for (int phase = 0; phase < NB_TIMERS; phase++)
+    {
+        mine[phase] = bench->phase_times[phase]*per_iteration;
+        local_max[phase].value = mine[phase];
+        local_max[phase].rank = me;
+    }
+    MPI_Reduce(mine, sums, NB_TIMERS, MPI_DOUBLE, MPI_SUM, 0, comm);
+    MPI_Reduce(mine, mins, NB_TIMERS, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(local_max, global_max, NB_TIMERS, MPI_DOUBLE_INT, MPI_MAXLOC, 0, comm);
+    for (int phase = 0; phase < NB_TIMERS && me == 0; phase++)
+    {
+        stats[phase].avg = sums[phase]/NPROC;
+        stats[phase].min = mins[phase];
+        stats[phase].max = global_max[phase].value;
+        stats[phase].max_rank = global_max[phase].rank;
+    }
+}
+
+
+/**
+ * Print the time per iteration of each phase over the processors (processor 0, --profile) :
+ * the imbalance is the maximum over the average (1 : all the processors spend the same time)
+ */
+static void print_profile(const phase_stats stats[NB_TIMERS], int NPROC)
+{
+    if (!TIMERS_ENABLED)
+    {
+        printf("Profile: the timers are removed at compile time (-DLAPLACE_NO_TIMERS)\n");
+        return;
+    }
+    printf("Profile: time per iteration of each phase over the %d processors (seconds)\n", NPROC);
+    printf("  %-12s %12s %12s %12s %8s %10s\n", "phase", "min", "avg", "max", "max on", "imbalance");
+    for (int phase = 0; phase < NB_TIMERS; phase++)
+    {
+        printf("  %-12s %12.4e %12.4e %12.4e %8d %10.2f\n", timer_name(phase), stats[phase].min, stats[phase].avg, stats[phase].max,
+               stats[phase].max_rank, stats[phase].avg > 0 ? stats[phase].max/stats[phase].avg : 1.0);
+    }
+}
+
+
+int report_benchmark(const benchmark *bench, MPI_Comm comm, const solver_options *options, const char *program,
+                     int ndims, const int *dims, int N)
+{
+    if (!is_benchmark(options) && !options->profile) { return 0; }
+
+    int me, NPROC, failed = 0;
+    MPI_Comm_rank(comm, &me);
+    MPI_Comm_size(comm, &NPROC);
+    phase_stats phases[NB_TIMERS];
+    reduce_phases(bench, comm, phases);
+    if (me != 0)
+    {
+        MPI_Bcast(&failed, 1, MPI_INT, 0, comm);
+        return -failed;
+    }
+    if (options->profile)
+    {
+        print_profile(phases, NPROC);
+    }
+    if (!is_benchmark(options))
+    {
+        MPI_Bcast(&failed, 1, MPI_INT, 0, comm);
+        return 0;
+    }
+
+    int trials = bench->trials, iterations = bench->iterations > 0 ? bench->iterations : 1;
+    double *sorted = (double*)malloc(trials*sizeof(double));
+    if (sorted == NULL) { exit(-1); } // Check if the memory has been well allocated
+    memcpy(sorted, bench->times, trials*sizeof(double));
+    qsort(sorted, trials, sizeof(double), compare_times);
+    double time_min = sorted[0], time_mean = 0;
+    double time_median = (trials % 2 == 1) ? sorted[trials/2] : 0.5*(sorted[trials/2-1] + sorted[trials/2]);
+    for (int t = 0; t < trials; t++)
+    {
+        time_mean += sorted[t]/trials;
+    }
+    free(sorted);
+
+    double updates = (double)iterations;
+    for (int d = 0; d < ndims; d++)
+    {
+        updates *= N; // significant values of the whole matrix
+    }
+    double time_per_iter = time_min/iterations;
+    double glups = (time_min > 0) ? updates/time_min*1e-9 : 0;
+    double bandwidth = glups*bytes_per_update(options->method); // GB/s
+    const char *kernel = (options->backend == BACKEND_GPU) ? "gpu" : stencil_kernel_name();
+    const char *decomposition = (ndims == 3) ? "box" : (options->decomposition == DECOMPOSITION_SLAB) ? "slab" : "block";
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    char grid[64], date[32], bandwidth_text[32];
+    if (ndims == 3) { snprintf(grid, sizeof(grid), "%dx%dx%d", dims[0], dims[1], dims[2]); }
+    else            { snprintf(grid, sizeof(grid), "%dx%d", dims[0], dims[1]); }
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    printf("Benchmark: %d trials (+%d warm-up) of %d iterations - time min %lf s, median %lf s, mean %lf s\n",
+           trials, bench->warmup, bench->iterations, time_min, time_median, time_mean);
+    printf("Benchmark: %e s per iteration, %.3f GLUP/s", time_per_iter, glups);
+    if (bandwidth > 0) { printf(", %.2f GB/s", bandwidth); }
+    printf(" - per iteration (average) :");
+    for (int phase = 0; phase < NB_TIMERS; phase++)
+    {
+        printf(" %s %e s", timer_name(phase), phases[phase].avg);
+    }
+    printf("\n");
+
+    FILE *f = NULL;
+    if (options->report != NULL && (f = fopen(options->report, "a")) == NULL)
+    {
+        perror("report_benchmark: fopen ");
+        failed = 1;
+    }
+    if (f != NULL && options->report_format == REPORT_CSV)
+    {
+        if (ftell(f) == 0) // new file : header line
+        {
+            fprintf(f, "date,program,method,decomposition,precision,kernel,processors,threads,grid,N,iterations,warmup,trials,"
+                       "time_min,time_median,time_mean,time_per_iteration,glups,bandwidth_gbs");
+            for (int phase = 0; phase < NB_TIMERS; phase++)
+            {
+                const char *name = timer_name(phase);
+                fprintf(f, ",%s_avg,%s_min,%s_max", name, name, name);
+            }
+            fprintf(f, "\n");
+        }
+        if (bandwidth > 0) { snprintf(bandwidth_text, sizeof(bandwidth_text), "%.6g", bandwidth); }
+        else               { bandwidth_text[0] = '\0'; } // no model
+        fprintf(f, "%s,%s,%s,%s,%s,%s,%d,%d,%s,%d,%d,%d,%d,%.9g,%.9g,%.9g,%.9g,%.6g,%s",
+                date, program, method_name(options->method), decomposition, PRECISION_NAME, kernel, NPROC, threads, grid, N,
+                bench->iterations, bench->warmup, trials, time_min, time_median, time_mean, time_per_iter, glups, bandwidth_text);
+        for (int phase = 0; phase < NB_TIMERS; phase++)
+        {
+            fprintf(f, ",%.9g,%.9g,%.9g", phases[phase].avg, phases[phase].min, phases[phase].max);
+        }
+        fprintf(f, "\n");
+    }
+    else if (f != NULL) // JSON Lines : an object per run
+    {
+        if (bandwidth > 0) { snprintf(bandwidth_text, sizeof(bandwidth_text), "%.6g", bandwidth); }
+        else               { snprintf(bandwidth_text, sizeof(bandwidth_text), "null"); } // no model
+        fprintf(f, "{\"date\": \"%s\", \"program\": \"%s\", \"method\": \"%s\", \"decomposition\": \"%s\", \"precision\": \"%s\", \"kernel\": \"%s\", "
+                   "\"processors\": %d, \"threads\": %d, \"grid\": \"%s\", \"N\": %d, \"iterations\": %d, \"warmup\": %d, \"trials\": %d, "
+                   "\"time_min\": %.9g, \"time_median\": %.9g, \"time_mean\": %.9g, \"time_per_iteration\": %.9g, \"glups\": %.6g, \"bandwidth_gbs\": %s, \"times\": [",
+                date, program, method_name(options->method), decomposition, PRECISION_NAME, kernel, NPROC, threads, grid, N,
+                bench->iterations, bench->warmup, trials, time_min, time_median, time_mean, time_per_iter, glups, bandwidth_text);
+        for (int t = 0; t < trials; t++)
+        {
+            fprintf(f, "%s%.9g", t > 0 ? ", " : "", bench->times[t]);
+        }
+        fprintf(f, "], \"per_iteration\": {");
+        for (int phase = 0; phase < NB_TIMERS; phase++)
+        {
+            fprintf(f, "%s\"%s\": {\"avg\": %.9g, \"min\": %.9g, \"max\": %.9g, \"max_rank\": %d}", phase > 0 ? ", " : "", timer_name(phase),
+                    phases[phase].avg, phases[phase].min, phases[phase].max, phases[phase].max_rank);
+        }
+        fprintf(f, "}}\n");
+    }
+    if (f != NULL) { fclose(f); }
+
+    MPI_Bcast(&failed, 1, MPI_INT, 0, comm);
+    return -failed;
+}
+
+
+void free_benchmark(benchmark *bench)
+{
+    free(bench->times);
+}
@@ -0,0 +1,73 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Benchmark mode, shared by all the programs : warm-up and measured trials of the computation, report of the measures
+
+Each trial computes the laplace equation from the initial values (or from the checkpoint with --restart),
+the warm-up trials are not measured. The time of a trial is the maximum over the processors, from a barrier
+to the end of the iterations (the initialization and the result file are not included).
+Derived measures, from the fastest trial :
+    time per iteration
+    GLUP/s : giga lattice updates per second (significant values of the whole matrix x iterations / time)
+    bandwidth : bytes a lattice update has to move at least (jacobi : read and write a value, gauss-seidel and sor :
+                twice, a sweep per colour), x GLUP/s ; not given for multigrid and cg
+    phases : time per iteration in each phase of timers.h over the measured trials : average, minimum and maximum
+             over the processors (the maximum shows the load imbalance and the network stalls of the slowest processors)
+
+----------------------------------------------------------------------
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "mpi.h"
+#include "options.h"
+#include "timers.h"
+
+
+/**
+ * Measures of the trials of a run
+ */
+typedef struct
+{
+    int warmup, trials;             // number of warm-up and of measured trials
+    int nb_done;                    // trials completed, warm-up included
+    double *times;                  // time of each measured trial (maximum over the processors)
+    double phase_times[NB_TIMERS];  // my time in each phase, summed over the measured trials
+    int iterations;                 // iterations computed by the last trial
+    double trial_start;             // MPI_Wtime() of the beginning of the trial in progress
+} benchmark;
+
+
+/**
+ * Prepare the measures of warmup + trials computations
+ */
+void init_benchmark(benchmark *bench, int warmup, int trials);
+
+/**
+ * Start a trial (collective on comm) : synchronize the processors and reset the timers of the phases
+ */
+void start_trial(benchmark *bench, MPI_Comm comm);
+
+/**
+ * End a trial of iterations iterations (collective on comm) : its time is reduced, and recorded if it is not a warm-up trial
+ */
+void end_trial(benchmark *bench, MPI_Comm comm, int iterations);
+
+/**
+ * Print the measures of the trials (processor 0) and append them to options->report if it is not NULL (benchmark runs),
+ * and print the phases over the processors with options->profile (collective on comm, nothing is done otherwise).
+ * program, ndims, dims and N describe the run : name of the program, grid of processors and dimension of the matrix.
+ * Returns 0 on success, -1 if the report cannot be written (the processor 0 prints the error)
+ */
+int report_benchmark(const benchmark *bench, MPI_Comm comm, const solver_options *options, const char *program,
+                     int ndims, const int *dims, int N);
+
+/**
+ * Release the measures
+ */
+void free_benchmark(benchmark *bench);
+
+
+#endif
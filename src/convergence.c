@@ -0,0 +1,211 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Convergence checks of the iterations : reduction of the error, checkpoints, snapshots and messages
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <math.h>
+#include "convergence.h"
+#include "timers.h"
+
+
+/**
+ * Print the error of the iteration (processor 0), every options->log_every iterations if options->verbosity >= 1
+ */
+static void print_error(const convergence_monitor *monitor, int iteration)
+{
+    const solver_options *options = monitor->options;
+    if (monitor->me == 0 && options->verbosity >= 1 && iteration % options->log_every == 0)
+    {
+        printf( "Iteration %d - error = %e\n", iteration, monitor->error );
+    }
+}
+
+
+void init_convergence(convergence_monitor *monitor, const solver_options *options, MPI_Comm comm, const block_layout *layout)
+{
+    monitor->options = options;
+    monitor->comm = comm;
+    MPI_Comm_rank(comm, &monitor->me);
+    monitor->error = +INFINITY;
+    monitor->iteration = 0;
+    monitor->req = MPI_REQUEST_NULL;
+    monitor->pending_iter = 0;
+    monitor->local_sums[0] = monitor->local_sums[1] = 0;
+    monitor->global_sums[0] = monitor->global_sums[1] = 0;
+    monitor->with_norms = uses_change_norms(options);
+    clear_change_norms(&monitor->local_norms);
+    clear_change_norms(&monitor->global_norms);
+    init_checkpoint(&monitor->checkpoint, options->checkpoint, comm, layout);
+    monitor->checkpoint_now = 0;
+    if (options->snapshot_every > 0)
+    {
+        output_view view;
+        init_output_view(&view, options);
+        init_output_writer(&monitor->snapshots, &view, comm, layout);
+    }
+}
+
+
+int is_converged(const convergence_monitor *monitor)
+{
+    return monitor->error < monitor->options->tolerance;
+}
+
+
+void set_convergence_error(convergence_monitor *monitor, int iteration, double error, double checkpoint_flag)
+{
+    monitor->error = error;
+    monitor->iteration = iteration;
+    monitor->checkpoint_now = (checkpoint_flag > 0);
+    print_error(monitor, iteration);
+}
+
+
+/**
+ * Error and checkpoint flag of the reduced sums or norms
+ */
+static void set_reduced_error(convergence_monitor *monitor, int iteration)
+{
+    const solver_options *options = monitor->options;
+    if (monitor->with_norms)
+    {
+        set_convergence_error(monitor, iteration, change_norm(&monitor->global_norms, options->norm, options->deterministic), monitor->global_norms.checkpoint);
+    }
+    else
+    {
+        set_convergence_error(monitor, iteration, sqrt(monitor->global_sums[0]), monitor->global_sums[1]);
+    }
+}
+
+
+int wait_convergence_check(convergence_monitor *monitor)
+{
+    if (monitor->req == MPI_REQUEST_NULL) { return 0; }
+    timer_switch(TIMER_REDUCTION);
+    MPI_Wait(&monitor->req, MPI_STATUS_IGNORE);
+    timer_switch(TIMER_COMPUTE);
+    set_reduced_error(monitor, monitor->pending_iter);
+    return is_converged(monitor);
+}
+
+
+void check_convergence(convergence_monitor *monitor, int iteration, double local_error_sum, const change_norms *norms)
+{
+    const solver_options *options = monitor->options;
+    double checkpoint_flag = checkpoint_interval_elapsed(&monitor->checkpoint, options->checkpoint_interval);
+    MPI_Request *request = options->async_check ? &monitor->req : NULL; // checked at the end of the next iteration
+    timer_switch(TIMER_REDUCTION);
+    if (monitor->with_norms) // the sums, the maximum and the checkpoint flag in a single reduction
+    {
+        monitor->local_norms = *norms;
+        monitor->local_norms.checkpoint = checkpoint_flag;
+        reduce_change_norms(&monitor->local_norms, &monitor->global_norms, monitor->comm, request);
+    }
+    else if (request != NULL)
+    {
+        monitor->local_sums[0] = local_error_sum;
+        monitor->local_sums[1] = checkpoint_flag;
+        MPI_Iallreduce( monitor->local_sums, monitor->global_sums, 2, MPI_DOUBLE, MPI_SUM, monitor->comm, request );
+    }
+    else
+    {
+        monitor->local_sums[0] = local_error_sum;
+        monitor->local_sums[1] = checkpoint_flag;
+        MPI_Allreduce( monitor->local_sums, monitor->global_sums, 2, MPI_DOUBLE, MPI_SUM, monitor->comm ); // we sum errors of all processors
+    }
+    timer_switch(TIMER_COMPUTE);
+    if (request != NULL)
+    {
+        monitor->pending_iter = iteration;
+    }
+    else
+    {
+        set_reduced_error(monitor, iteration);
+    }
+}
+
+
+/**
+ * Returns 1 if a checkpoint is due after the iteration : not once converged
+ */
+static int checkpoint_due(const convergence_monitor *monitor, int iteration)
+{
+    const solver_options *options = monitor->options;
+    return !is_converged(monitor) && (monitor->checkpoint_now || (options->checkpoint_every > 0 && iteration % options->checkpoint_every == 0));
+}
+
+
+int convergence_outputs_due(const convergence_monitor *monitor, int iteration)
+{
+    const solver_options *options = monitor->options;
+    return checkpoint_due(monitor, iteration) || (options->snapshot_every > 0 && iteration % options->snapshot_every == 0);
+}
+
+
+void save_convergence_outputs(convergence_monitor *monitor, const real *local_tab, int iteration)
+{
+    const solver_options *options = monitor->options;
+    if (checkpoint_due(monitor, iteration))
+    {
+        timer_switch(TIMER_OTHER);
+        start_checkpoint(&monitor->checkpoint, local_tab, iteration, monitor->error); // written during the next iterations
+        timer_switch(TIMER_COMPUTE);
+        monitor->checkpoint_now = 0;
+    }
+    if (options->snapshot_every > 0 && iteration % options->snapshot_every == 0)
+    {
+        char filename[512];
+        timer_switch(TIMER_OTHER);
+        indexed_filename(options->output, iteration, filename, sizeof(filename));
+        start_output(&monitor->snapshots, filename, local_tab); // written during the next iterations
+        timer_switch(TIMER_COMPUTE);
+    }
+}
+
+
+void resize_convergence(convergence_monitor *monitor, const block_layout *layout)
+{
+    resize_checkpoint(&monitor->checkpoint, layout);
+    if (monitor->options->snapshot_every > 0) { resize_output_writer(&monitor->snapshots, layout); }
+}
+
+
+void finish_convergence(convergence_monitor *monitor, const real *local_tab, int iteration)
+{
+    const solver_options *options = monitor->options;
+    if (monitor->req != MPI_REQUEST_NULL) // the loop stopped (max_iter) with a reduction in flight
+    {
+        MPI_Wait(&monitor->req, MPI_STATUS_IGNORE);
+        monitor->error = monitor->with_norms ? change_norm(&monitor->global_norms, options->norm, options->deterministic) : sqrt(monitor->global_sums[0]);
+        monitor->iteration = monitor->pending_iter;
+    }
+    if (!is_converged(monitor) && monitor->checkpoint.iteration != iteration)
+    {
+        start_checkpoint(&monitor->checkpoint, local_tab, iteration, monitor->error); // the computation can be continued with --restart
+    }
+    free_checkpoint(&monitor->checkpoint);
+    if (options->snapshot_every > 0) { free_output_writer(&monitor->snapshots); }
+
+    if (monitor->me != 0 || options->verbosity < 1) { return; }
+    if (!is_converged(monitor))
+    {
+        printf( "WARNING: maximum number of iterations reached (%d), the error is still %e\n", iteration, monitor->error );
+    }
+    else
+    {
+        printf( "Converged after %d iterations - error = %e\n", iteration, monitor->error );
+    }
+    if (monitor->with_norms && monitor->iteration > 0)
+    {
+        const change_norms *norms = &monitor->global_norms;
+        printf( "Norms of the change at iteration %d%s: l2 = %e, max = %e, relative = %e\n", monitor->iteration, options->deterministic ? " (exact sums)" : "",
+                change_norm(norms, NORM_L2, options->deterministic), change_norm(norms, NORM_MAX, options->deterministic),
+                change_norm(norms, NORM_RELATIVE, options->deterministic) );
+    }
+}
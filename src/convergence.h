@@ -0,0 +1,98 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Convergence checks of the iterations, shared by the solvers (solver.h, offload.h, solver3d.h)
+
+Every options->check_every iterations, the error of the iteration is reduced with the checkpoint flag (the processor 0 decides
+when --checkpoint-interval has elapsed) : the sum of the squared changes of the kernels, or the norms of norms.h (--norm,
+--deterministic). With options->async_check, the reduction (MPI_Iallreduce) overlaps the next iteration, which is computed
+even if the loop stops. The monitor also writes the checkpoints and the snapshots (--snapshot-every) in the background,
+and prints the errors and the final messages (processor 0, options->verbosity >= 1).
+
+----------------------------------------------------------------------
+*/
+
+#ifndef CONVERGENCE_H
+#define CONVERGENCE_H
+
+#include "mpi.h"
+#include "precision.h"
+#include "options.h"
+#include "io.h"
+#include "output.h"
+#include "norms.h"
+
+
+/**
+ * State of the convergence checks of a solver
+ */
+typedef struct
+{
+    const solver_options *options;
+    int me;                     // my rank in comm
+    MPI_Comm comm;
+    double error;               // error of the last check (+INFINITY before the first one)
+    int iteration;              // iteration of the last check (0 : none)
+    MPI_Request req;            // reduction in flight (options->async_check)
+    int pending_iter;           // iteration of the reduction in flight
+    double local_sums[2], global_sums[2]; // error, checkpoint needed (time) of the reduction in flight
+    int with_norms;             // 1 : the error is a norm of norms.h (uses_change_norms)
+    change_norms local_norms, global_norms; // norms of the reduction in flight, reduced norms of the last check
+    checkpoint_writer checkpoint;
+    int checkpoint_now;         // set by the reduction when the last checkpoint is older than options->checkpoint_interval
+    output_writer snapshots;    // --snapshot-every : views of the values written in the background
+} convergence_monitor;
+
+
+/**
+ * Prepare the checks of the local matrices described by layout (position of the block in the local matrices of the solver),
+ * with their checkpoints and snapshots (collective on comm)
+ */
+void init_convergence(convergence_monitor *monitor, const solver_options *options, MPI_Comm comm, const block_layout *layout);
+
+/**
+ * Returns 1 if the error of the last check is lower than the tolerance, 0 otherwise
+ */
+int is_converged(const convergence_monitor *monitor);
+
+/**
+ * Set the error of the iteration, reduced by the solver with the checkpoint flag (conjugate gradient), and print it
+ */
+void set_convergence_error(convergence_monitor *monitor, int iteration, double error, double checkpoint_flag);
+
+/**
+ * Complete the reduction in flight, if any (collective) : returns 1 if its error is lower than the tolerance, 0 otherwise
+ */
+int wait_convergence_check(convergence_monitor *monitor);
+
+/**
+ * Reduce the error of the iteration (collective) : the sum of the squared changes of my block, or my norms with the norms
+ * of norms.h (norms, NULL otherwise). At once, or in the background with options->async_check (see wait_convergence_check)
+ */
+void check_convergence(convergence_monitor *monitor, int iteration, double local_error_sum, const change_norms *norms);
+
+/**
+ * Returns 1 if save_convergence_outputs writes a checkpoint or a snapshot after the iteration, 0 otherwise
+ * (the values must then be on the host)
+ */
+int convergence_outputs_due(const convergence_monitor *monitor, int iteration);
+
+/**
+ * Start the checkpoint and the snapshot of the values of the iteration, when they are due (collective)
+ */
+void save_convergence_outputs(convergence_monitor *monitor, const real *local_tab, int iteration);
+
+/**
+ * Complete the writes in flight, and prepare the next ones for the new block layout of my local matrix (load balancing)
+ */
+void resize_convergence(convergence_monitor *monitor, const block_layout *layout);
+
+/**
+ * End of the loop after the iteration (collective) : complete the reduction in flight, write a last checkpoint if the values
+ * have not converged, release the writers and print the final messages
+ */
+void finish_convergence(convergence_monitor *monitor, const real *local_tab, int iteration);
+
+
+#endif
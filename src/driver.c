@@ -0,0 +1,219 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Main program shared by laplace_1D and laplace_2D
+
+----------------------------------------------------------------------
+*/
+
+
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "driver.h"
+#include "stencil.h"
+#include "io.h"
+#include "grid.h"
+#include "multigrid.h"
+#include "solver.h"
+#include "bench.h"
+#include "affinity.h"
+#include "offload.h"
+#include "batch.h"
+#include "output.h"
+#include "guess.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+void print_banner(int me, const solver_options *options, int thread_support)
+{
+    if (me == 0 && options->verbosity >= 1)
+    {
+        printf("Stencil kernel: %s (%s precision)\n", options->backend == BACKEND_GPU ? "gpu" : stencil_kernel_name(), PRECISION_NAME);
+#ifdef _OPENMP
+        printf("Hybrid mode: %d OpenMP threads per processor\n", omp_get_max_threads());
+        if (thread_support < MPI_THREAD_FUNNELED) { printf("WARNING: the MPI library does not support MPI_THREAD_FUNNELED\n"); }
+#else
+        (void)thread_support;
+#endif
+    }
+}
+
+
+void print_times(double local_time, MPI_Comm comm, int me, int NPROC)
+{
+    double max_time, min_time, avg_time;
+    MPI_Reduce(&local_time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+    MPI_Reduce(&local_time, &min_time, 1, MPI_DOUBLE, MPI_MIN, 0, comm);
+    MPI_Reduce(&local_time, &avg_time, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+    if (me == 0)
+    {
+        avg_time /= NPROC;
+        printf("\nMin: %lf seconds.  Max: %lf seconds.  Avg:  %lf seconds.\n", min_time, max_time, avg_time);
+    }
+}
+
+
+const char *output_filename(const solver_options *options, const char *name, char *buffer, int size)
+{
+    snprintf(buffer, size, "result_%s.%s", name, options->format == OUTPUT_TEXT ? "txt" : options->format == OUTPUT_COMPRESSED ? "lpz" : "bin");
+    return options->output ? options->output : buffer;
+}
+
+
+int laplace_main(int argc, char *argv[], decomposition_kind default_decomposition, const char *name)
+{
+    int thread_support; // hybrid mode : only the main thread calls MPI, the OpenMP threads share the stencil computation
+    MPI_Init_thread( &argc, &argv, MPI_THREAD_FUNNELED, &thread_support );
+    int NPROC, me ; // NPROC : number of processors, me : rank of the actual processor
+    double start_time, local_time;
+
+    MPI_Comm_rank( MPI_COMM_WORLD, &me );
+    MPI_Comm_size( MPI_COMM_WORLD, &NPROC );
+
+    solver_options options;
+    if (parse_options(argc, argv, me, &options) != 0)
+    {
+        MPI_Finalize();
+        exit(-1);
+    }
+    int N = options.N; // square matrix dimension
+    char default_output[256];
+    options.output = output_filename(&options, name, default_output, sizeof(default_output)); // also the base name of the snapshots
+    if (options.decomposition == DECOMPOSITION_DEFAULT)
+    {
+        options.decomposition = default_decomposition;
+    }
+
+    // PARTITIONING
+    int dims[2]; // In how many parts rows (dims[0]) and columns (dims[1]) of the original matrix are cut
+    decomposition_dims(options.decomposition, NPROC, dims);
+    if (N < dims[0] || N < dims[1])
+    {
+        if (me == 0) { printf("ERROR: imcompatible number of processors and matrix size. The %d processors are organized in a %d x %d grid, so the matrix dimension N should be at least %d, but we have N = %d\n", NPROC, dims[0], dims[1], dims[0] > dims[1] ? dims[0] : dims[1], N); }
+        MPI_Finalize();
+        exit(-1);
+    }
+    if (options.backend == BACKEND_GPU && !offload_available())
+    {
+        if (me == 0) { printf("ERROR: --backend gpu needs a build with -fopenmp -DLAPLACE_OFFLOAD\n"); }
+        MPI_Finalize();
+        exit(-1);
+    }
+    if (N/dims[0] < options.halo_depth || N/dims[1] < options.halo_depth)
+    {
+        if (me == 0) { printf("ERROR: --halo-depth %d needs blocks of at least %d x %d values : with %d processors in a %d x %d grid, N should be at least %d\n", options.halo_depth, options.halo_depth, options.halo_depth, NPROC, dims[0], dims[1], options.halo_depth*(dims[0] > dims[1] ? dims[0] : dims[1])); }
+        MPI_Finalize();
+        exit(-1);
+    }
+    if ((options.method == METHOD_MULTIGRID || options.preconditioner == PRECONDITIONER_MULTIGRID) && (N/dims[0] < MG_MIN_BLOCK || N/dims[1] < MG_MIN_BLOCK))
+    {
+        if (me == 0) { printf("ERROR: the multigrid method needs blocks of at least %d x %d values : with %d processors in a %d x %d grid, N should be at least %d\n", MG_MIN_BLOCK, MG_MIN_BLOCK, NPROC, dims[0], dims[1], MG_MIN_BLOCK*(dims[0] > dims[1] ? dims[0] : dims[1])); }
+        MPI_Finalize();
+        exit(-1);
+    }
+
+    print_banner(me, &options, thread_support);
+    MPI_Barrier(MPI_COMM_WORLD);  // synchronize all processes
+
+    start_time = MPI_Wtime();  //get time just before work section, once the arguments are checked
+
+    processor_grid grid; // Cartesian communicator (my rank may change), my block and the halo exchange of my local matrix
+    init_grid(&grid, N, options.decomposition);
+    me = grid.me;
+    if (options.affinity) { print_affinity(grid.comm); }
+
+    set_huge_pages(options.huge_pages);
+    if (options.batch != NULL) // many problems of the same grid at once (batch.h) : a single iteration loop, a result file per problem
+    {
+        benchmark bench;
+        init_benchmark(&bench, 0, 1);
+        start_trial(&bench, grid.comm);
+        int iterations = laplace_batch(&grid, &options, name);
+        if (iterations < 0)
+        {
+            MPI_Finalize();
+            exit(-1);
+        }
+        end_trial(&bench, grid.comm, iterations);
+        print_times(MPI_Wtime() - start_time, grid.comm, me, NPROC);
+        report_benchmark(&bench, grid.comm, &options, name, 2, grid.dims, N); // --profile
+        free_benchmark(&bench);
+        free_grid(&grid);
+        MPI_Finalize();
+        return 0;
+    }
+
+    real* local_tab = NULL; // all the processors have their own local matrix containing the values of the original matrix their are responsible of + neighbor values
+    local_tab = alloc_matrix(grid.Nlocal_rows, grid.Nlocal_cols); // first touched by the threads which compute its rows
+    if (local_tab == NULL) { exit(-1); } // Check if the memory has been well allocated
+
+    // COMPUTATION AND MATRIX FILLING : once, or the warm-up and the measured trials of a benchmark, each one from the initial values
+    benchmark bench;
+    init_benchmark(&bench, options.warmup, options.repeat);
+    for (int trial = 0; trial < options.warmup + options.repeat; trial++)
+    {
+        int first_iter = 0;
+        initialize_local_matrix(&grid, local_tab, &options);
+        if (!options.restart && set_initial_guess(&grid, local_tab, &options) != 0) // boundary, coarse or file (guess.h)
+        {
+            MPI_Finalize();
+            exit(-1);
+        }
+        if (options.restart)
+        {
+            double checkpoint_error;
+            if (read_checkpoint(options.checkpoint, grid.comm, local_tab, &grid.layout, &first_iter, &checkpoint_error) != 0)
+            {
+                MPI_Finalize();
+                exit(-1);
+            }
+            if (me == 0 && options.verbosity >= 1) { printf("Restart from %s after %d iterations - error = %e\n", options.checkpoint, first_iter, checkpoint_error); }
+        }
+        update_matrix (&grid.halo, local_tab); // first update of neighbors values
+        start_trial(&bench, grid.comm);
+        int iterations = laplace(&local_tab, &grid, &options, first_iter); // laplace computation. Comment this line to verify message sending/receiving and data structures.
+        end_trial(&bench, grid.comm, iterations);
+    }
+
+
+    // PERFORMANCE EVALUATION
+    local_time = MPI_Wtime() - start_time;  // get time just after work section
+    print_times(local_time, grid.comm, me, NPROC);
+    report_benchmark(&bench, grid.comm, &options, name, 2, grid.dims, N);
+    free_benchmark(&bench);
+
+    const char *output = options.output;
+    if (options.verbosity >= 1 && options.format == OUTPUT_TEXT)
+    {
+        print_and_save_final_matrix(output, &grid, local_tab, options.verbosity);
+    }
+    else if (options.verbosity >= 1) // each processor writes its block directly in the file
+    {
+        write_output(output, grid.comm, local_tab, &grid.layout, &options); // the view of the options (output.h)
+        if (options.verbosity >= 2)
+        {
+            print_and_save_final_matrix(NULL, &grid, local_tab, options.verbosity); // printing only
+        }
+    }
+
+    // Print all the local matrices (not for performance evaluation section)
+    for (int i = 0; i < NPROC && options.verbosity >= 2; i++)
+    {
+        if (me == i)
+        {
+            print_matrix(i, local_tab, grid.Nlocal_rows, grid.Nlocal_cols);
+        }
+        MPI_Barrier(grid.comm);  // synchronize all processes to prevent "overlap" during the printing
+    }
+
+    free_grid(&grid);
+    MPI_Finalize();
+    free(local_tab);
+    return 0;
+}
+
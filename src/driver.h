@@ -0,0 +1,49 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Main programs : laplace_1D and laplace_2D share laplace_main (driver.c, they only differ by their default decomposition),
+laplace_3D runs laplace_main_3d (driver3d.c)
+
+----------------------------------------------------------------------
+*/
+
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include "mpi.h"
+#include "options.h"
+
+
+/**
+ * Run the solver with the command line options (MPI_Init to MPI_Finalize) : check the options, decompose the matrix,
+ * compute the laplace equation, print the times and save the result.
+ * default_decomposition is used without --decomposition, name gives the default names of the result files (result_<name>.txt/.bin).
+ * Returns the exit status of the program.
+ */
+int laplace_main(int argc, char *argv[], decomposition_kind default_decomposition, const char *name);
+
+/**
+ * Print the stencil kernel and the OpenMP threads used (processor 0, verbosity >= 1)
+ */
+void print_banner(int me, const solver_options *options, int thread_support);
+
+/**
+ * Reduce the times of the work section on comm and print the minimum, maximum and average ones (processor 0)
+ */
+void print_times(double local_time, MPI_Comm comm, int me, int NPROC);
+
+/**
+ * Name of the result file : options->output, or result_<name>.txt, result_<name>.bin or result_<name>.lpz (compressed, written in buffer)
+ */
+const char *output_filename(const solver_options *options, const char *name, char *buffer, int size);
+
+/**
+ * Run the 3D solver (7-point stencil on a N x N x N matrix, Cartesian decomposition as cubic as possible) with the same
+ * options, times and result files as laplace_main. Only the jacobi, gauss-seidel and sor methods are available.
+ * Returns the exit status of the program.
+ */
+int laplace_main_3d(int argc, char *argv[], const char *name);
+
+
+#endif
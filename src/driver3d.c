@@ -0,0 +1,139 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Main program of laplace_3D
+
+----------------------------------------------------------------------
+*/
+
+
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include "driver.h"
+#include "io.h"
+#include "grid3d.h"
+#include "solver3d.h"
+#include "bench.h"
+#include "affinity.h"
+
+
+int laplace_main_3d(int argc, char *argv[], const char *name)
+{
+    int thread_support;
+    MPI_Init_thread( &argc, &argv, MPI_THREAD_FUNNELED, &thread_support );
+    int NPROC, me;
+    double start_time, local_time;
+
+    MPI_Comm_rank( MPI_COMM_WORLD, &me );
+    MPI_Comm_size( MPI_COMM_WORLD, &NPROC );
+
+    solver_options options;
+    if (parse_options(argc, argv, me, &options) != 0)
+    {
+        MPI_Finalize();
+        exit(-1);
+    }
+    int N = options.N; // cubic matrix dimension
+    if (options.method == METHOD_MULTIGRID || options.method == METHOD_CG || options.halo_depth > 1 || options.tile_cols != 0
+        || options.decomposition != DECOMPOSITION_DEFAULT || options.backend != BACKEND_CPU
+        || options.balance_every > 0 || options.batch != NULL || options.initial > INITIAL_CONSTANT
+        || options.norm != NORM_L2 || options.deterministic)
+    {
+        if (me == 0) { printf("ERROR: %s only supports --method jacobi, gauss-seidel or sor, without --halo-depth, --tile-cols, --wavefront, --decomposition, --backend, --balance-every, --batch, --initial boundary or coarse, --initial-file, --norm and --deterministic\n", name); }
+        MPI_Finalize();
+        exit(-1);
+    }
+    if (options.format == OUTPUT_COMPRESSED || options.output_stride > 1 || options.snapshot_every > 0
+        || options.region[0] != 0 || options.region[1] != N || options.region[2] != 0 || options.region[3] != N)
+    {
+        if (me == 0) { printf("ERROR: %s writes the whole matrix : without --output-region, --output-stride, --snapshot-every and --output-format compressed\n", name); }
+        MPI_Finalize();
+        exit(-1);
+    }
+
+    // PARTITIONING
+    int dims[3] = {0, 0, 0}; // In how many parts planes, rows and columns of the original matrix are cut
+    MPI_Dims_create(NPROC, 3, dims);
+    if (N < dims[0])
+    {
+        if (me == 0) { printf("ERROR: imcompatible number of processors and matrix size. The %d processors are organized in a %d x %d x %d grid, so the matrix dimension N should be at least %d, but we have N = %d\n", NPROC, dims[0], dims[1], dims[2], dims[0], N); }
+        MPI_Finalize();
+        exit(-1);
+    }
+
+    print_banner(me, &options, thread_support);
+    MPI_Barrier(MPI_COMM_WORLD);  // synchronize all processes
+
+    start_time = MPI_Wtime();  //get time just before work section, once the arguments are checked
+
+    processor_grid_3d grid; // Cartesian communicator (my rank may change), my box and the exchange of its faces
+    init_grid_3d(&grid, N);
+    me = grid.me;
+    if (options.affinity) { print_affinity(grid.comm); }
+
+    set_huge_pages(options.huge_pages);
+    real* local_tab = alloc_matrix(grid.Nlocal[0]*grid.Nlocal[1], grid.Nlocal[2]); // first touched by the threads which compute its rows
+    if (local_tab == NULL) { exit(-1); } // Check if the memory has been well allocated
+
+    // COMPUTATION AND MATRIX FILLING : once, or the warm-up and the measured trials of a benchmark
+    benchmark bench;
+    init_benchmark(&bench, options.warmup, options.repeat);
+    for (int trial = 0; trial < options.warmup + options.repeat; trial++)
+    {
+        int first_iter = 0;
+        initialize_local_matrix_3d(&grid, local_tab, &options);
+        if (options.restart)
+        {
+            double checkpoint_error;
+            if (read_checkpoint(options.checkpoint, grid.comm, local_tab, &grid.layout, &first_iter, &checkpoint_error) != 0)
+            {
+                MPI_Finalize();
+                exit(-1);
+            }
+            if (me == 0 && options.verbosity >= 1) { printf("Restart from %s after %d iterations - error = %e\n", options.checkpoint, first_iter, checkpoint_error); }
+        }
+        update_matrix (&grid.halo, local_tab); // first update of neighbors values
+        start_trial(&bench, grid.comm);
+        int iterations = laplace_3d(local_tab, &grid, &options, first_iter);
+        end_trial(&bench, grid.comm, iterations);
+    }
+
+
+    // PERFORMANCE EVALUATION
+    local_time = MPI_Wtime() - start_time;  // get time just after work section
+    print_times(local_time, grid.comm, me, NPROC);
+    report_benchmark(&bench, grid.comm, &options, name, 3, grid.dims, N);
+    free_benchmark(&bench);
+
+    char default_output[256];
+    const char *output = output_filename(&options, name, default_output, sizeof(default_output));
+    if (options.verbosity >= 1 && options.format == OUTPUT_TEXT)
+    {
+        print_and_save_final_matrix_3d(output, &grid, local_tab, options.verbosity);
+    }
+    else if (options.verbosity >= 1) // each processor writes its box directly in the file
+    {
+        write_binary_matrix(output, grid.comm, local_tab, &grid.layout, options.format == OUTPUT_BINARY);
+        if (options.verbosity >= 2)
+        {
+            print_and_save_final_matrix_3d(NULL, &grid, local_tab, options.verbosity); // printing only
+        }
+    }
+
+    // Print all the local matrices (not for performance evaluation section)
+    for (int i = 0; i < NPROC && options.verbosity >= 2; i++)
+    {
+        if (me == i)
+        {
+            print_matrix_3d(i, local_tab, grid.Nlocal);
+        }
+        MPI_Barrier(grid.comm);  // synchronize all processes to prevent "overlap" during the printing
+    }
+
+    free_grid_3d(&grid);
+    MPI_Finalize();
+    free(local_tab);
+    return 0;
+}
@@ -0,0 +1,493 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Decomposition of the matrix between the processors and exchange of the adjacent values, shared by all the solvers
+
+The halo exchanges are neighborhood collectives (MPI_Ineighbor_alltoallw) : a single request per update,
+whatever the number of neighbors of the decomposition.
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "grid.h"
+#include "timers.h"
+#include "stencil.h"
+#include "affinity.h"
+
+
+void print_matrix(int me, const real *tab, int nb_rows, int nb_cols)
+{
+    printf("\n \n Matrix printed by me: %d \n \n", me);
+    for(int i = 0; i<nb_rows; i++)
+    {
+        for(int j = 0; j<nb_cols; j++)
+        {
+            printf(" %.2f", *(tab+j+i*nb_cols));  // Change ".2f" to "%d" for more clarity (test mode, without laplace calculation)
+            //printf(" %d",(int) *(tab+j+i*nb_cols));
+        }
+        printf("\n");
+    }
+}
+
+
+/**
+ * Print the matrix given in parameter, in decreasing rows index order
+ */
+static void print_matrix_reverse(int me, const real *tab, int nb_rows, int nb_cols)
+{
+    printf("\n \n Matrix printed by me: %d \n", me);
+    for (int i = nb_rows-1; i>=0; i--)
+    {
+        for(int j = 0; j<nb_cols; j++)
+        {
+            printf(" %.2f",*(tab+j+i*nb_cols)); // Change ".2f" to "%d" for more clarity (test mode, without laplace calculation)
+            //printf(" %d",(int) *(tab+j+i*nb_cols));
+        }
+        printf("\n");
+    }
+}
+
+
+void init_halo_exchange(halo_exchange *halo, MPI_Comm cart_comm, int Nlocal_rows, int Nlocal_cols)
+{
+    init_batch_halo_exchange(halo, cart_comm, Nlocal_rows, Nlocal_cols, 1);
+}
+
+
+void init_batch_halo_exchange(halo_exchange *halo, MPI_Comm cart_comm, int Nlocal_rows, int Nlocal_cols, int nb_values)
+{
+    halo->comm = cart_comm;
+    halo->depth = 1;
+    halo->nb_neighbors = 4;
+
+    int row_values = Nlocal_cols*nb_values; // values of a row of the local matrix
+    MPI_Type_contiguous((Nlocal_cols-2)*nb_values, LAPLACE_MPI_REAL, &halo->row);
+    MPI_Type_commit(&halo->row);
+    MPI_Type_vector(Nlocal_rows-2, nb_values, row_values, LAPLACE_MPI_REAL, &halo->column);
+    MPI_Type_commit(&halo->column);
+
+    /*
+     *    1. Processor above me : I send my first SIGNIFICANT row (index 1+Nlocal_cols) and it refreshes my first ADJACENT row (index 1)
+     */
+    halo->send_displs[0] = (1+Nlocal_cols) * nb_values * sizeof(real);
+    halo->recv_displs[0] = 1 * nb_values * sizeof(real);
+    halo->types[0] = halo->row;
+
+    /*
+     *    2. Processor under me : I send my last SIGNIFICANT row (index 1+(Nlocal_rows-2)*Nlocal_cols) and it refreshes my last ADJACENT row (index 1+(Nlocal_rows-1)*Nlocal_cols)
+     */
+    halo->send_displs[1] = (1+(Nlocal_rows-2)*Nlocal_cols) * nb_values * sizeof(real);
+    halo->recv_displs[1] = (1+(Nlocal_rows-1)*Nlocal_cols) * nb_values * sizeof(real);
+    halo->types[1] = halo->row;
+
+    /*
+     *    3. Processor on my left : I send my first SIGNIFICANT column (index Nlocal_cols+1) and it refreshes my first ADJACENT column (index Nlocal_cols)
+     */
+    halo->send_displs[2] = (Nlocal_cols+1) * nb_values * sizeof(real);
+    halo->recv_displs[2] = Nlocal_cols * nb_values * sizeof(real);
+    halo->types[2] = halo->column;
+
+    /*
+     *    4. Processor on my right : I send my last SIGNIFICANT column (index Nlocal_cols*2-2) and it refreshes my last ADJACENT column (index Nlocal_cols*2-1)
+     */
+    halo->send_displs[3] = (Nlocal_cols*2-2) * nb_values * sizeof(real);
+    halo->recv_displs[3] = (Nlocal_cols*2-1) * nb_values * sizeof(real);
+    halo->types[3] = halo->column;
+
+    for (int i = 0; i < 4; i++)
+    {
+        halo->counts[i] = 1;
+    }
+    halo->req = MPI_REQUEST_NULL;
+}
+
+
+void init_deep_halo_exchange(halo_exchange *halo, MPI_Comm cart_comm, int Nlocal_rows, int Nlocal_cols, int depth)
+{
+    int dims[2], periods[2], coords[2];
+    MPI_Cart_get(cart_comm, 2, dims, periods, coords);
+    int block_rows = Nlocal_rows - 2*depth;
+    int block_cols = Nlocal_cols - 2*depth;
+    int local_sizes[2] = {Nlocal_rows, Nlocal_cols}, zero[2] = {0, 0};
+    int neighbors[8];
+
+    halo->depth = depth;
+    halo->row = halo->column = MPI_DATATYPE_NULL;
+    halo->nb_neighbors = 0;
+    for (int di = -1; di <= 1; di++)
+    {
+        for (int dj = -1; dj <= 1; dj++)
+        {
+            int neighbor_coords[2] = {coords[0]+di, coords[1]+dj};
+            if ((di == 0 && dj == 0) || neighbor_coords[0] < 0 || neighbor_coords[0] >= dims[0] || neighbor_coords[1] < 0 || neighbor_coords[1] >= dims[1])
+            {
+                continue;
+            }
+            int n = halo->nb_neighbors++;
+            MPI_Cart_rank(cart_comm, neighbor_coords, &neighbors[n]);
+
+            int sizes[2] = {(di == 0) ? block_rows : depth, (dj == 0) ? block_cols : depth};
+            MPI_Type_create_subarray(2, local_sizes, sizes, zero, MPI_ORDER_C, LAPLACE_MPI_REAL, &halo->types[n]);
+            MPI_Type_commit(&halo->types[n]);
+
+            // I send my first (last) depth SIGNIFICANT rows/columns, and the neighbor refreshes the depth ADJACENT ones before (after) my block
+            int send_row = (di <= 0) ? depth : block_rows;
+            int send_col = (dj <= 0) ? depth : block_cols;
+            int recv_row = (di < 0) ? 0 : (di == 0) ? depth : depth+block_rows;
+            int recv_col = (dj < 0) ? 0 : (dj == 0) ? depth : depth+block_cols;
+            halo->send_displs[n] = ((MPI_Aint)send_row*Nlocal_cols + send_col) * sizeof(real);
+            halo->recv_displs[n] = ((MPI_Aint)recv_row*Nlocal_cols + recv_col) * sizeof(real);
+            halo->counts[n] = 1;
+        }
+    }
+    int weights[8] = {1, 1, 1, 1, 1, 1, 1, 1}; // all the messages have the same weight (MPI_UNWEIGHTED is a null array for the compiler)
+    MPI_Dist_graph_create_adjacent(cart_comm, halo->nb_neighbors, neighbors, weights, halo->nb_neighbors, neighbors, weights,
+                                   MPI_INFO_NULL, 0, &halo->comm);
+    halo->req = MPI_REQUEST_NULL;
+}
+
+
+void free_halo_exchange(halo_exchange *halo)
+{
+    if (halo->depth == 1)
+    {
+        MPI_Type_free(&halo->row);
+        MPI_Type_free(&halo->column);
+        return;
+    }
+    for (int n = 0; n < halo->nb_neighbors; n++)
+    {
+        MPI_Type_free(&halo->types[n]);
+    }
+    MPI_Comm_free(&halo->comm);
+}
+
+
+void start_update_matrix(halo_exchange *halo, real *local_tab)
+{
+    timer_phase previous = timer_switch(TIMER_HALO_START);
+    MPI_Ineighbor_alltoallw(local_tab, halo->counts, halo->send_displs, halo->types,
+                            local_tab, halo->counts, halo->recv_displs, halo->types, halo->comm, &halo->req);
+    timer_switch(previous);
+}
+
+
+void wait_update_matrix(halo_exchange *halo)
+{
+    timer_phase previous = timer_switch(TIMER_HALO_WAIT);
+    MPI_Wait(&halo->req, MPI_STATUS_IGNORE);
+    timer_switch(previous);
+}
+
+
+void update_matrix(halo_exchange *halo, real *local_tab)
+{
+    start_update_matrix(halo, local_tab);
+    wait_update_matrix(halo);
+}
+
+
+void block_range(int N, int nb_parts, int index, int *first, int *size)
+{
+    int remainder = N%nb_parts;
+    *size  = N/nb_parts + (index < remainder ? 1 : 0);
+    *first = index*(N/nb_parts) + (index < remainder ? index : remainder);
+}
+
+void decomposition_dims(decomposition_kind kind, int NPROC, int dims[2])
+{
+    dims[0] = dims[1] = 0;
+    if (kind == DECOMPOSITION_SLAB)
+    {
+        dims[0] = NPROC; // whole rows : no left and right neighbors, the messages are contiguous rows
+        dims[1] = 1;
+    }
+    else
+    {
+        MPI_Dims_create(NPROC, 2, dims); // In how many parts rows (dims[0]) and columns (dims[1]) of the original matrix are cut, as square as possible
+    }
+}
+
+
+/**
+ * Dimensions of my local matrix, position of my block and halo exchange, from the limits of the blocks in grid
+ */
+static void set_my_block(processor_grid *grid)
+{
+    int N = grid->row_splits[grid->dims[0]];
+    int first_row = grid->row_splits[grid->coords[0]], first_col = grid->col_splits[grid->coords[1]];
+    int NBLOCK_rows = grid->row_splits[grid->coords[0]+1] - first_row; // number of SIGNIFICANT rows and columns in my BLOCK
+    int NBLOCK_cols = grid->col_splits[grid->coords[1]+1] - first_col;
+    grid->Nlocal_rows = NBLOCK_rows+2; // "real" number of rows of a local matrix. We added +2 for the neibhbors (ADJACENT values).
+    grid->Nlocal_cols = NBLOCK_cols+2; // "real" number of columns of a local matrix
+
+    block_layout layout = { 2, {N, N}, {NBLOCK_rows, NBLOCK_cols}, {first_row, first_col}, {grid->Nlocal_rows, grid->Nlocal_cols}, {1, 1} }; // position of my block in the whole matrix (files)
+    grid->layout = layout;
+    init_halo_exchange(&grid->halo, grid->comm, grid->Nlocal_rows, grid->Nlocal_cols);
+}
+
+
+void init_grid(processor_grid *grid, int N, decomposition_kind kind)
+{
+    grid->kind = kind;
+    MPI_Comm_size(MPI_COMM_WORLD, &grid->NPROC);
+    decomposition_dims(kind, grid->NPROC, grid->dims);
+
+    // CARTESIAN TOPOLOGY : the MPI library may reorder the ranks to put neighbor blocks on the same node
+    int periods[2] = {0, 0}; // no periodicity : the edges of the matrix keep their ADJACENT values
+    MPI_Cart_create(MPI_COMM_WORLD, 2, grid->dims, periods, 1, &grid->comm);
+    MPI_Comm_rank(grid->comm, &grid->me); // my rank may have changed, it gives the position of my block : (me/dims[1], me%dims[1])
+    MPI_Cart_coords(grid->comm, grid->me, 2, grid->coords);
+
+    int *dims = grid->dims, *coords = grid->coords;
+    grid->has_neighbor[0] = (coords[0] > 0);
+    grid->has_neighbor[1] = (coords[0] < dims[0]-1);
+    grid->has_neighbor[2] = (coords[1] > 0);
+    grid->has_neighbor[3] = (coords[1] < dims[1]-1);
+
+    // Limits of the blocks : the remainder of N is spread over the first processors
+    grid->row_splits = (int*)malloc((dims[0]+1)*sizeof(int));
+    grid->col_splits = (int*)malloc((dims[1]+1)*sizeof(int));
+    if (grid->row_splits == NULL || grid->col_splits == NULL) { exit(-1); } // Check if the memory has been well allocated
+    for (int k = 0; k < 2; k++)
+    {
+        int *splits = (k == 0) ? grid->row_splits : grid->col_splits;
+        for (int index = 0; index < dims[k]; index++)
+        {
+            int size;
+            block_range(N, dims[k], index, &splits[index], &size);
+        }
+        splits[dims[k]] = N;
+    }
+    set_my_block(grid);
+}
+
+
+void free_grid(processor_grid *grid)
+{
+    free_halo_exchange(&grid->halo);
+    MPI_Comm_free(&grid->comm);
+    free(grid->row_splits);
+    free(grid->col_splits);
+}
+
+
+/**
+ * Overlap of the blocks [first ; first+size[ and [other_first ; other_first+size[ in one dimension : returns its size (0 : none)
+ * and its first index in start
+ */
+static int overlap(int first, int size, int other_first, int other_size, int *start)
+{
+    *start = (first > other_first) ? first : other_first;
+    int end = (first+size < other_first+other_size) ? first+size : other_first+other_size;
+    return (end > *start) ? end - *start : 0;
+}
+
+
+void repartition_grid(processor_grid *grid, const int *row_splits, const int *col_splits, real **local_tab)
+{
+    int NPROC = grid->NPROC;
+    const int *dims = grid->dims;
+    int old_local_sizes[2] = {grid->Nlocal_rows, grid->Nlocal_cols};
+    int old_starts[2] = {grid->layout.starts[0], grid->layout.starts[1]};
+    real *old_tab = *local_tab;
+
+    int *new_row_splits = (int*)malloc((dims[0]+1)*sizeof(int));
+    int *new_col_splits = (int*)malloc((dims[1]+1)*sizeof(int));
+    MPI_Request *reqs = (MPI_Request*)malloc(2*NPROC*sizeof(MPI_Request));
+    if (new_row_splits == NULL || new_col_splits == NULL || reqs == NULL) { exit(-1); } // Check if the memory has been well allocated
+    memcpy(new_row_splits, row_splits, (dims[0]+1)*sizeof(int));
+    memcpy(new_col_splits, col_splits, (dims[1]+1)*sizeof(int));
+    int *splits[2][2] = {{grid->row_splits, grid->col_splits}, {new_row_splits, new_col_splits}}; // old and new limits
+
+    // My new local matrix : the boundary values of the edges of the old one, the adjacent values of the neighbors come with the update
+    free_halo_exchange(&grid->halo);
+    grid->row_splits = new_row_splits;
+    grid->col_splits = new_col_splits;
+    set_my_block(grid);
+    int nb_rows = grid->Nlocal_rows, nb_cols = grid->Nlocal_cols;
+    int new_local_sizes[2] = {nb_rows, nb_cols};
+    real *new_tab = alloc_matrix(nb_rows, nb_cols);
+    if (new_tab == NULL) { exit(-1); } // Check if the memory has been well allocated
+    real edges[4] = {old_tab[1], old_tab[1 + (old_local_sizes[0]-1)*old_local_sizes[1]], old_tab[old_local_sizes[1]], old_tab[2*old_local_sizes[1]-1]};
+    for (int j = 0; j < nb_cols; j++)
+    {
+        new_tab[j] = edges[0];
+        new_tab[j + (nb_rows-1)*nb_cols] = edges[1];
+    }
+    for (int i = 1; i < nb_rows-1; i++)
+    {
+        new_tab[i*nb_cols] = edges[2];
+        new_tab[i*nb_cols + nb_cols-1] = edges[3];
+    }
+
+    /*
+        The values of each overlap of my old block and the new block of a processor are sent to it (a subarray of my old
+        local matrix), the values of each overlap of the old block of a processor and my new block are received at their
+        position in my new local matrix. The limits move by a few rows or columns : the messages go to the neighbors
+        (and to myself, for the values I keep).
+    */
+    int nb_reqs = 0;
+    for (int i = 0; i < NPROC; i++)
+    {
+        int coords[2] = {i/dims[1], i%dims[1]};
+        for (int direction = 0; direction < 2; direction++) // 0 : my old block to the new block of i, 1 : the old block of i to my new block
+        {
+            int starts[2], sizes[2], local_starts[2];
+            int *local_sizes = (direction == 0) ? old_local_sizes : new_local_sizes;
+            int empty = 0;
+            for (int k = 0; k < 2; k++)
+            {
+                int *from = splits[0][k], *to = splits[1][k];
+                int from_index = (direction == 0) ? grid->coords[k] : coords[k];
+                int to_index   = (direction == 0) ? coords[k] : grid->coords[k];
+                sizes[k] = overlap(from[from_index], from[from_index+1] - from[from_index], to[to_index], to[to_index+1] - to[to_index], &starts[k]);
+                local_starts[k] = starts[k] - ((direction == 0) ? old_starts[k] : grid->layout.starts[k]) + 1;
+                empty |= (sizes[k] == 0);
+            }
+            if (empty) { continue; }
+
+            MPI_Datatype block;
+            MPI_Type_create_subarray(2, local_sizes, sizes, local_starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &block);
+            MPI_Type_commit(&block);
+            if (direction == 0) { MPI_Isend(old_tab, 1, block, i, 0, grid->comm, &reqs[nb_reqs++]); }
+            else                { MPI_Irecv(new_tab, 1, block, i, 0, grid->comm, &reqs[nb_reqs++]); }
+            MPI_Type_free(&block); // the datatype is only released when the communication is complete
+        }
+    }
+    MPI_Waitall(nb_reqs, reqs, MPI_STATUSES_IGNORE);
+
+    free(reqs);
+    free(splits[0][0]);
+    free(splits[0][1]);
+    free(old_tab);
+    update_matrix(&grid->halo, new_tab);
+    *local_tab = new_tab;
+}
+
+
+void initialize_local_matrix(const processor_grid *grid, real *local_tab, const solver_options *options)
+{
+    int nb_rows = grid->Nlocal_rows, nb_cols = grid->Nlocal_cols;
+    real first_row_value = (grid->coords[0] == 0)               ? options->boundary[EDGE_BOTTOM] : -1;
+    real last_row_value  = (grid->coords[0] == grid->dims[0]-1) ? options->boundary[EDGE_TOP]    : -1;
+    real first_col_value = (grid->coords[1] == 0)               ? options->boundary[EDGE_LEFT]   : -1;
+    real last_col_value  = (grid->coords[1] == grid->dims[1]-1) ? options->boundary[EDGE_RIGHT]  : -1;
+    real initial_value   = (options->initial == INITIAL_RANK) ? grid->me : options->initial_value;
+
+    #pragma omp parallel for schedule(static) if((long)nb_rows*nb_cols >= STENCIL_MIN_PARALLEL_CELLS) // rows of the threads of alloc_matrix
+    for(int i = 0; i<nb_rows; i++)
+    {
+        for(int j = 0; j<nb_cols; j++)
+        {
+            if (i == 0)
+            {
+                *(local_tab+j+i*nb_cols) = first_row_value;
+            }
+            else if (i == nb_rows-1)
+            {
+                *(local_tab+j+i*nb_cols) = last_row_value;
+            }
+            else if (j == 0)
+            {
+                *(local_tab+j+i*nb_cols) = first_col_value;
+            }
+            else if (j == nb_cols-1)
+            {
+                *(local_tab+j+i*nb_cols) = last_col_value;
+            }
+            else
+            {
+                *(local_tab+j+i*nb_cols) = initial_value;
+            }
+        }
+    }
+}
+
+
+void print_and_save_final_matrix(const char *filename, const processor_grid *grid, const real *local_tab, int verbosity)
+{
+    MPI_Comm comm = grid->comm;
+    int me = grid->me, NPROC = grid->NPROC, N = grid->layout.global_sizes[0];
+    int Nlocal_rows = grid->Nlocal_rows, Nlocal_cols = grid->Nlocal_cols;
+    const int *dims = grid->dims;
+    MPI_Request send_req;
+
+    MPI_Datatype mysubarray; // creates a datatype for a subarray of a regular, multidimensional array : we will use it on local_tab to extract only significant values
+    int starts[2] = {1, 1}; // starting coordinates (i,j) of the subarray : our first significant element in local_tab is at (1,1)
+    int subsizes[2]  = {Nlocal_rows-2, Nlocal_cols-2}; // dimensions of the subarray (significant values) to extract
+    int bigsizes[2]  = {Nlocal_rows, Nlocal_cols}; // dimensions of the array (local_tab) in which we want to extract a subarray (significant values)
+
+    MPI_Type_create_subarray(2, bigsizes, subsizes, starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &mysubarray); // create the new datatype ; 2 = number of dimensions
+    MPI_Type_commit(&mysubarray); // commit the datatype
+
+    MPI_Isend(local_tab, 1, mysubarray, 0, me, comm, &send_req); // send significant values of local_tab (using new datatype) to processor 0
+
+    MPI_Type_free(&mysubarray);
+
+    if(me == 0) // processor 0 is responsible of gathering all the data
+    {
+        real *final_matrix = (real*)malloc(N*N*sizeof(real));
+        MPI_Request *recv_reqs = (MPI_Request*)malloc(NPROC*sizeof(MPI_Request));
+        if (final_matrix == NULL || recv_reqs == NULL) { exit(-1); } // Check if the memory has been well allocated
+
+        /*
+            Receive the block of each processor at its position in final_matrix : the processor i owns the rows of the block
+            i/dims[1] and the columns of the block i%dims[1] (row_splits, col_splits)
+            2 2 2 2 2 3 3 3 3 3
+            2 2 2 2 2 3 3 3 3 3      print_matrix_reverse() : the row 0 is printed at the bottom
+            0 0 0 0 0 1 1 1 1 1
+            0 0 0 0 0 1 1 1 1 1
+        */
+        int final_sizes[2] = {N, N};
+        for (int i = 0; i < NPROC; i++)
+        {
+            int block_coords[2] = {i/dims[1], i%dims[1]};
+            int block_starts[2] = {grid->row_splits[block_coords[0]], grid->col_splits[block_coords[1]]};
+            int block_sizes[2]  = {grid->row_splits[block_coords[0]+1] - block_starts[0], grid->col_splits[block_coords[1]+1] - block_starts[1]};
+
+            MPI_Datatype block; // position of the block of processor i in final_matrix
+            MPI_Type_create_subarray(2, final_sizes, block_sizes, block_starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &block);
+            MPI_Type_commit(&block);
+            MPI_Irecv(final_matrix, 1, block, i, i, comm, &recv_reqs[i]);
+            MPI_Type_free(&block); // the datatype is only released when the reception is complete
+        }
+        MPI_Waitall(NPROC, recv_reqs, MPI_STATUSES_IGNORE);
+        free(recv_reqs);
+
+        // Print the final matrix
+        if (verbosity >= 2)
+        {
+            printf( "Final solution is:" );
+            print_matrix_reverse(me, final_matrix, N, N);
+            printf( "\n ------------------------------- \n" );
+        }
+
+        // Save the final matrix in a file (reverse order)
+        FILE *f;
+        if (filename != NULL)
+        {
+            if ((f = fopen (filename, "w")) == NULL) { perror ("matrix_save: fopen "); }
+            for (int i = N-1; i>=0; i--)
+
+            {
+                for (int j=0; j<N; j++)
+                {
+                    fprintf (f, "%f ", *(final_matrix + j + i*N) ); // Change ".2f" to "%d" for more clarity (test mode, without laplace calculation)
+                    //fprintf (f, "%d ", (int) *(final_matrix + j + i*N) );
+                }
+                fprintf (f, "\n");
+            }
+            fclose (f);
+        }
+
+        free(final_matrix);
+    }
+
+    MPI_Wait(&send_req, MPI_STATUS_IGNORE);
+}
@@ -0,0 +1,176 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Decomposition of the matrix between the processors and exchange of the adjacent values, shared by all the solvers
+
+The processors are organized in a 2D Cartesian grid of dims[0] x dims[1] processors (not periodic) :
+    slab decomposition (laplace_1D) : dims = NPROC x 1, each processor owns whole rows
+    block decomposition (laplace_2D) : dims as square as possible (MPI_Dims_create)
+Each local matrix has one ADJACENT layer around its block of SIGNIFICANT values : the values of the neighbors,
+or the boundary values on the edges of the whole matrix, so the stencil kernels have no edge effect to handle.
+The blocks of a row (column) of processors have the same rows (columns) : N/dims[0] rows in each row of processors at start,
+their limits may then be moved by repartition_grid (load balancing, see balance.h).
+
+----------------------------------------------------------------------
+*/
+
+#ifndef GRID_H
+#define GRID_H
+
+#include "mpi.h"
+#include "precision.h"
+#include "options.h"
+#include "io.h"
+
+
+/**
+ * Halo exchange context : the communicator and the description of the messages updating the adjacent data of a local matrix.
+ * It is created once before the laplace loop, so that each iteration only starts and completes one neighborhood collective.
+ * Depth 1 : 4 messages on the Cartesian communicator, the neighbors are ordered as MPI_Cart_shift gives them :
+ * above (row-1), under (row+1), left (col-1), right (col+1).
+ * Depth > 1 (deep halo) : depth adjacent layers, corners included, exchanged with the (up to) 8 neighbors of a graph communicator.
+ */
+typedef struct
+{
+    MPI_Comm comm;              // 2D Cartesian communicator (dims[0] x dims[1] processors, not periodic), or graph of the 8 neighbors
+    int depth;                  // number of ADJACENT layers around the block
+    MPI_Datatype row;           // depth 1 : a SIGNIFICANT row : Nlocal_cols-2 contiguous values
+    MPI_Datatype column;        // depth 1 : a SIGNIFICANT column : Nlocal_rows-2 values separated by Nlocal_cols
+    int nb_neighbors;
+    int counts[8];              // one row or one column (one block of layers) per neighbor
+    MPI_Aint send_displs[8];    // position (in bytes) of the SIGNIFICANT values sent to each neighbor
+    MPI_Aint recv_displs[8];    // position (in bytes) of the ADJACENT values received from each neighbor
+    MPI_Datatype types[8];      // datatype exchanged with each neighbor
+    MPI_Request req;            // request of the neighborhood collective in flight
+} halo_exchange;
+
+
+/**
+ * Decomposition of the N x N matrix : my block, my local matrix and the exchange of its adjacent data
+ */
+typedef struct
+{
+    decomposition_kind kind;    // DECOMPOSITION_SLAB or DECOMPOSITION_BLOCK
+    MPI_Comm comm;              // Cartesian communicator of all the processors
+    int NPROC, me;              // number of processors, my rank in comm (the ranks may be reordered by MPI_Cart_create)
+    int dims[2];                // rows and columns of the grid of processors
+    int coords[2];              // position of my block in the grid of processors
+    int has_neighbor[4];        // 1 if there is a processor above, under, on the left, on the right of mine
+    int Nlocal_rows, Nlocal_cols; // dimensions of my local matrix : SIGNIFICANT values + 2 ADJACENT layers
+    block_layout layout;        // position of my block in the whole matrix (files)
+    halo_exchange halo;         // datatypes and displacements of the adjacent data, reused by all the iterations
+    int *row_splits;            // first row of the blocks of each row of processors (dims[0]+1 values, the last one is N)
+    int *col_splits;            // first column of the blocks of each column of processors (dims[1]+1 values, the last one is N)
+} processor_grid;
+
+
+/**
+ * Give the first index and the size of the part number index, when N rows (or columns) are cut in nb_parts parts
+ * The N%nb_parts first parts get one more row (or column) when N is not a multiple of nb_parts
+ */
+void block_range(int N, int nb_parts, int index, int *first, int *size);
+
+
+/**
+ * Grid of processors of a decomposition of the NPROC processors of MPI_COMM_WORLD, without creating it :
+ * NPROC x 1 for DECOMPOSITION_SLAB, as square as possible for DECOMPOSITION_BLOCK
+ */
+void decomposition_dims(decomposition_kind kind, int NPROC, int dims[2]);
+
+
+/**
+ * Create the decomposition of the N x N matrix on all the processors (collective) : the Cartesian communicator,
+ * my block and the halo exchange of my local matrix. The grid of processors must have at most N rows and columns.
+ */
+void init_grid(processor_grid *grid, int N, decomposition_kind kind);
+
+/**
+ * Free the communicator and the halo exchange of the decomposition
+ */
+void free_grid(processor_grid *grid);
+
+/**
+ * Move the limits of the blocks to row_splits and col_splits (same format as in processor_grid, at least a row and
+ * a column per block), collective : each processor sends the values it loses to their new owners, usually its neighbors
+ * (a subarray message per overlap of blocks, as the halo messages), *local_tab is replaced by a new local matrix
+ * with the same boundary values and up-to-date adjacent data, and the layout and the halo exchange describe the new block.
+ */
+void repartition_grid(processor_grid *grid, const int *row_splits, const int *col_splits, real **local_tab);
+
+
+/**
+ * Create the halo exchange context of a local matrix of Nlocal_rows x Nlocal_cols values, on the Cartesian communicator cart_comm
+ * The rows and columns do not overlap (no corner is needed by the stencil), so the 4 messages can be exchanged at once.
+ * On the edges of the grid of processors, the missing neighbors are MPI_PROC_NULL and their ADJACENT data are left unchanged.
+ */
+void init_halo_exchange(halo_exchange *halo, MPI_Comm cart_comm, int Nlocal_rows, int Nlocal_cols);
+
+/**
+ * Halo exchange of a batch of local matrices stored interleaved (batch.h) : each cell holds nb_values contiguous values,
+ * so a single message per neighbor carries the adjacent rows (columns) of all the matrices. nb_values = 1 : init_halo_exchange.
+ */
+void init_batch_halo_exchange(halo_exchange *halo, MPI_Comm cart_comm, int Nlocal_rows, int Nlocal_cols, int nb_values);
+
+/**
+ * Create the deep halo exchange of a local matrix with depth ADJACENT layers around its block (Nlocal_rows-2*depth rows
+ * and Nlocal_cols-2*depth columns), on the graph of the 8 neighbors of cart_comm : the neighbors in the same row or column of
+ * processors send depth SIGNIFICANT rows or columns, the diagonal ones a depth x depth corner, so that an exchange is enough for
+ * depth iterations. All the blocks must have at least depth rows and columns.
+ * Each message is a subarray of the local matrix, at the position given by its displacement.
+ */
+void init_deep_halo_exchange(halo_exchange *halo, MPI_Comm cart_comm, int Nlocal_rows, int Nlocal_cols, int depth);
+
+/**
+ * Free the datatypes of the halo exchange context (and the graph communicator of a deep halo)
+ */
+void free_halo_exchange(halo_exchange *halo);
+
+/**
+ * Start the update of the adjacent data (rows and columns) of the local matrix (non-blocking)
+ */
+void start_update_matrix(halo_exchange *halo, real *local_tab);
+
+/**
+ * Wait for the end of the update of the adjacent data started by start_update_matrix
+ */
+void wait_update_matrix(halo_exchange *halo);
+
+/**
+ * Update values of the adjacent data (rows and columns) of all the local matrices
+ */
+void update_matrix(halo_exchange *halo, real *local_tab);
+
+
+/**
+ * Initialize the local matrix : all the values are set to the initial guess (by default the rank of the processor), except the adjacent values.
+ * The guesses INITIAL_BOUNDARY, INITIAL_COARSE and INITIAL_FILE set them to 0 : set_initial_guess (guess.h) computes them next.
+ * On the edges of the grid of processors, the adjacent values outside the matrix are set to the boundary values
+ * (-1 by default) : bottom edge for the row 0, top edge for the last row, left and right edges for the first and last columns.
+ * The other adjacent values are set to -1, until the first update.
+ * Example : for processor of rank = 0 and a local matrix 5x5, the result is :
+ * -1 -1 -1 -1 -1
+   -1  0  0  0 -1
+   -1  0  0  0 -1
+   -1  0  0  0 -1
+   -1 -1 -1 -1 -1
+ */
+void initialize_local_matrix(const processor_grid *grid, real *local_tab, const solver_options *options);
+
+
+/**
+ * Print the local matrix given in parameter (SIGNIFICANT and ADJACENT values), in increasing indexes order
+ */
+void print_matrix(int me, const real *tab, int nb_rows, int nb_cols);
+
+
+/**
+ * Gather all the local matrices data from the processors and print the whole reconstructed matrix
+ * The processor 0 receives each block directly at its position in the final matrix (one subarray datatype per processor),
+ * so the whole matrix is assembled in a single N x N buffer, without intermediate copies
+ * The final matrix is only printed with verbosity >= 2, and the file is not saved if filename is NULL
+ */
+void print_and_save_final_matrix(const char *filename, const processor_grid *grid, const real *local_tab, int verbosity);
+
+
+#endif
@@ -0,0 +1,247 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Decomposition of the 3D matrix (laplace_3D) between the processors and exchange of the adjacent faces
+
+The 6 faces are exchanged by the neighborhood collective of grid.c (start_update_matrix) : a single request per update.
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "grid3d.h"
+#include "stencil.h"
+
+
+/**
+ * Index of the value (plane, row, col) in a matrix of nb_values[0] x nb_values[1] x nb_values[2] values
+ */
+static long index_3d(const int nb_values[3], int plane, int row, int col)
+{
+    return ((long)plane*nb_values[1] + row)*nb_values[2] + col;
+}
+
+
+/**
+ * Print the plane of index plane of the matrix given in parameter, in decreasing rows index order
+ */
+static void print_plane_reverse(const real *tab, const int nb_values[3], int plane)
+{
+    printf("\n Plane %d:\n", plane);
+    for (int i = nb_values[1]-1; i >= 0; i--)
+    {
+        for (int j = 0; j < nb_values[2]; j++)
+        {
+            printf(" %.2f", tab[index_3d(nb_values, plane, i, j)]);
+        }
+        printf("\n");
+    }
+}
+
+
+void print_matrix_3d(int me, const real *tab, const int nb_values[3])
+{
+    printf("\n \n Matrix printed by me: %d \n", me);
+    for (int k = 0; k < nb_values[0]; k++)
+    {
+        printf("\n Plane %d:\n", k);
+        for (int i = 0; i < nb_values[1]; i++)
+        {
+            for (int j = 0; j < nb_values[2]; j++)
+            {
+                printf(" %.2f", tab[index_3d(nb_values, k, i, j)]);
+            }
+            printf("\n");
+        }
+    }
+}
+
+
+/**
+ * Create the halo exchange of the 6 faces of the local matrix on the Cartesian communicator of the grid
+ * The neighborhood collective orders the neighbors of a Cartesian communicator as MPI_Cart_shift gives them, dimension by dimension :
+ * plane-1, plane+1, row-1, row+1, col-1, col+1. On the edges of the grid, the missing neighbors are MPI_PROC_NULL.
+ */
+static void init_face_exchange(processor_grid_3d *grid)
+{
+    halo_exchange *halo = &grid->halo;
+    const int *local_sizes = grid->Nlocal;
+    int zero[3] = {0, 0, 0};
+
+    halo->comm = grid->comm;
+    halo->depth = 1;
+    halo->row = halo->column = MPI_DATATYPE_NULL; // 2D only
+    halo->nb_neighbors = 6;
+    for (int d = 0; d < 3; d++)
+    {
+        // One layer in the dimension d, the SIGNIFICANT values in the 2 other ones : contiguous rows for the planes,
+        // rows of different planes for the rows, columns of different planes (a vector of vectors) for the columns
+        int sizes[3];
+        for (int e = 0; e < 3; e++)
+        {
+            sizes[e] = (e == d) ? 1 : local_sizes[e]-2;
+        }
+        MPI_Type_create_subarray(3, local_sizes, sizes, zero, MPI_ORDER_C, LAPLACE_MPI_REAL, &grid->faces[d]);
+        MPI_Type_commit(&grid->faces[d]);
+
+        for (int side = 0; side < 2; side++)
+        {
+            // I send my first (last) SIGNIFICANT face and the neighbor refreshes my first (last) ADJACENT face
+            int send[3] = {1, 1, 1}, recv[3] = {1, 1, 1};
+            send[d] = (side == 0) ? 1 : local_sizes[d]-2;
+            recv[d] = (side == 0) ? 0 : local_sizes[d]-1;
+            int n = 2*d + side;
+            halo->send_displs[n] = index_3d(local_sizes, send[0], send[1], send[2]) * sizeof(real);
+            halo->recv_displs[n] = index_3d(local_sizes, recv[0], recv[1], recv[2]) * sizeof(real);
+            halo->types[n] = grid->faces[d];
+            halo->counts[n] = 1;
+        }
+    }
+    halo->req = MPI_REQUEST_NULL;
+}
+
+
+void init_grid_3d(processor_grid_3d *grid, int N)
+{
+    MPI_Comm_size(MPI_COMM_WORLD, &grid->NPROC);
+    grid->dims[0] = grid->dims[1] = grid->dims[2] = 0;
+    MPI_Dims_create(grid->NPROC, 3, grid->dims); // as cubic as possible
+
+    int periods[3] = {0, 0, 0}; // no periodicity : the faces of the matrix keep their ADJACENT values
+    MPI_Cart_create(MPI_COMM_WORLD, 3, grid->dims, periods, 1, &grid->comm);
+    MPI_Comm_rank(grid->comm, &grid->me);
+    MPI_Cart_coords(grid->comm, grid->me, 3, grid->coords);
+
+    block_layout layout = { 3, {N, N, N}, {0}, {0}, {0}, {1, 1, 1} }; // position of my box in the whole matrix (files)
+    for (int d = 0; d < 3; d++)
+    {
+        grid->has_neighbor[2*d]   = (grid->coords[d] > 0);
+        grid->has_neighbor[2*d+1] = (grid->coords[d] < grid->dims[d]-1);
+        block_range(N, grid->dims[d], grid->coords[d], &layout.starts[d], &layout.sizes[d]);
+        grid->Nlocal[d] = layout.sizes[d]+2; // +2 for the ADJACENT faces
+        layout.local_sizes[d] = grid->Nlocal[d];
+    }
+    grid->layout = layout;
+    init_face_exchange(grid);
+}
+
+
+void free_grid_3d(processor_grid_3d *grid)
+{
+    for (int d = 0; d < 3; d++)
+    {
+        MPI_Type_free(&grid->faces[d]);
+    }
+    MPI_Comm_free(&grid->comm);
+}
+
+
+void initialize_local_matrix_3d(const processor_grid_3d *grid, real *local_tab, const solver_options *options)
+{
+    const int *nb_values = grid->Nlocal, *coords = grid->coords, *dims = grid->dims;
+    real first_plane_value = (coords[0] == 0)         ? options->boundary[EDGE_FRONT]  : -1;
+    real last_plane_value  = (coords[0] == dims[0]-1) ? options->boundary[EDGE_BACK]   : -1;
+    real first_row_value   = (coords[1] == 0)         ? options->boundary[EDGE_BOTTOM] : -1;
+    real last_row_value    = (coords[1] == dims[1]-1) ? options->boundary[EDGE_TOP]    : -1;
+    real first_col_value   = (coords[2] == 0)         ? options->boundary[EDGE_LEFT]   : -1;
+    real last_col_value    = (coords[2] == dims[2]-1) ? options->boundary[EDGE_RIGHT]  : -1;
+    real initial_value     = (options->initial == INITIAL_RANK) ? grid->me : options->initial_value;
+
+    #pragma omp parallel for collapse(2) schedule(static) if((long)nb_values[0]*nb_values[1]*nb_values[2] >= STENCIL_MIN_PARALLEL_CELLS) // as alloc_matrix
+    for (int k = 0; k < nb_values[0]; k++)
+    {
+        for (int i = 0; i < nb_values[1]; i++)
+        {
+            for (int j = 0; j < nb_values[2]; j++)
+            {
+                real value = initial_value;
+                if (k == 0)                     { value = first_plane_value; }
+                else if (k == nb_values[0]-1)   { value = last_plane_value; }
+                else if (i == 0)                { value = first_row_value; }
+                else if (i == nb_values[1]-1)   { value = last_row_value; }
+                else if (j == 0)                { value = first_col_value; }
+                else if (j == nb_values[2]-1)   { value = last_col_value; }
+                local_tab[index_3d(nb_values, k, i, j)] = value;
+            }
+        }
+    }
+}
+
+
+void print_and_save_final_matrix_3d(const char *filename, const processor_grid_3d *grid, const real *local_tab, int verbosity)
+{
+    MPI_Comm comm = grid->comm;
+    int me = grid->me, NPROC = grid->NPROC, N = grid->layout.global_sizes[0];
+    const int *dims = grid->dims;
+    MPI_Request send_req;
+
+    MPI_Datatype mysubarray; // SIGNIFICANT values of local_tab
+    int starts[3] = {1, 1, 1};
+    MPI_Type_create_subarray(3, grid->Nlocal, grid->layout.sizes, starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &mysubarray);
+    MPI_Type_commit(&mysubarray);
+    MPI_Isend(local_tab, 1, mysubarray, 0, me, comm, &send_req); // send significant values of local_tab to processor 0
+    MPI_Type_free(&mysubarray);
+
+    if (me == 0) // processor 0 is responsible of gathering all the data
+    {
+        int final_sizes[3] = {N, N, N};
+        real *final_matrix = (real*)malloc((size_t)N*N*N*sizeof(real));
+        MPI_Request *recv_reqs = (MPI_Request*)malloc(NPROC*sizeof(MPI_Request));
+        if (final_matrix == NULL || recv_reqs == NULL) { exit(-1); } // Check if the memory has been well allocated
+
+        for (int i = 0; i < NPROC; i++) // receive the box of each processor at its position in final_matrix
+        {
+            int coords[3], block_starts[3], block_sizes[3];
+            MPI_Cart_coords(comm, i, 3, coords);
+            for (int d = 0; d < 3; d++)
+            {
+                block_range(N, dims[d], coords[d], &block_starts[d], &block_sizes[d]);
+            }
+
+            MPI_Datatype block;
+            MPI_Type_create_subarray(3, final_sizes, block_sizes, block_starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &block);
+            MPI_Type_commit(&block);
+            MPI_Irecv(final_matrix, 1, block, i, i, comm, &recv_reqs[i]);
+            MPI_Type_free(&block); // the datatype is only released when the reception is complete
+        }
+        MPI_Waitall(NPROC, recv_reqs, MPI_STATUSES_IGNORE);
+        free(recv_reqs);
+
+        if (verbosity >= 2)
+        {
+            printf( "Final solution is:" );
+            for (int k = 0; k < N; k++)
+            {
+                print_plane_reverse(final_matrix, final_sizes, k);
+            }
+            printf( "\n ------------------------------- \n" );
+        }
+
+        // Save the final matrix in a file : plane by plane, each one in reverse rows order
+        FILE *f;
+        if (filename != NULL)
+        {
+            if ((f = fopen (filename, "w")) == NULL) { perror ("matrix_save: fopen "); }
+            for (int k = 0; k < N && f != NULL; k++)
+            {
+                if (k > 0) { fprintf (f, "\n"); }
+                for (int i = N-1; i >= 0; i--)
+                {
+                    for (int j = 0; j < N; j++)
+                    {
+                        fprintf (f, "%f ", final_matrix[index_3d(final_sizes, k, i, j)]);
+                    }
+                    fprintf (f, "\n");
+                }
+            }
+            if (f != NULL) { fclose (f); }
+        }
+
+        free(final_matrix);
+    }
+
+    MPI_Wait(&send_req, MPI_STATUS_IGNORE);
+}
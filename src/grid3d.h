@@ -0,0 +1,78 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Decomposition of the 3D matrix (laplace_3D) between the processors and exchange of the adjacent faces
+
+The processors are organized in a 3D Cartesian grid of dims[0] x dims[1] x dims[2] processors (not periodic),
+as cubic as possible (MPI_Dims_create) : each one owns a box of planes x rows x columns of the N x N x N matrix.
+As in 2D, each local matrix has one ADJACENT layer around its box of SIGNIFICANT values : the faces of the neighbors,
+or the boundary values on the faces of the whole matrix (the edges and the corners of the layer are not used by the 7-point stencil).
+
+----------------------------------------------------------------------
+*/
+
+#ifndef GRID3D_H
+#define GRID3D_H
+
+#include "mpi.h"
+#include "precision.h"
+#include "options.h"
+#include "io.h"
+#include "grid.h"
+
+
+/**
+ * Decomposition of the N x N x N matrix : my box, my local matrix and the exchange of its adjacent faces
+ */
+typedef struct
+{
+    MPI_Comm comm;              // 3D Cartesian communicator of all the processors
+    int NPROC, me;              // number of processors, my rank in comm (the ranks may be reordered by MPI_Cart_create)
+    int dims[3];                // planes, rows and columns of the grid of processors
+    int coords[3];              // position of my box in the grid of processors
+    int has_neighbor[6];        // 1 if there is a processor before, after my box in each dimension (plane-1, plane+1, row-1, row+1, col-1, col+1)
+    int Nlocal[3];              // dimensions of my local matrix : SIGNIFICANT values + 2 ADJACENT layers
+    block_layout layout;        // position of my box in the whole matrix (files)
+    MPI_Datatype faces[3];      // a SIGNIFICANT face orthogonal to each dimension (subarray of the local matrix)
+    halo_exchange halo;         // the 6 faces on the Cartesian communicator, in the order of MPI_Cart_shift
+} processor_grid_3d;
+
+
+/**
+ * Create the decomposition of the N x N x N matrix on all the processors (collective) : the Cartesian communicator,
+ * my box and the halo exchange of my local matrix. The grid of processors must have at most N processors in each dimension.
+ * The face orthogonal to the dimension d is a subarray of the local matrix (1 layer in d, the SIGNIFICANT values in the 2 other ones),
+ * so the same datatype sends my first and my last SIGNIFICANT faces and receives both ADJACENT faces : only the displacements differ.
+ */
+void init_grid_3d(processor_grid_3d *grid, int N);
+
+/**
+ * Free the communicator and the datatypes of the decomposition
+ */
+void free_grid_3d(processor_grid_3d *grid);
+
+
+/**
+ * Initialize the local matrix : all the values are set to the initial guess (by default the rank of the processor), except the adjacent values,
+ * set to the boundary values on the faces of the whole matrix (front and back for the first and last planes, bottom and top for the rows,
+ * left and right for the columns), and to -1 elsewhere until the first update.
+ */
+void initialize_local_matrix_3d(const processor_grid_3d *grid, real *local_tab, const solver_options *options);
+
+
+/**
+ * Print the local matrix given in parameter (SIGNIFICANT and ADJACENT values), plane by plane
+ */
+void print_matrix_3d(int me, const real *tab, const int nb_values[3]);
+
+
+/**
+ * Gather all the boxes on the processor 0 (one subarray datatype per processor, as in 2D) and print the whole reconstructed matrix
+ * Text file : each plane as a 2D matrix (the row 0 at the bottom), the plane 0 first, the planes separated by an empty line
+ * The final matrix is only printed with verbosity >= 2, and the file is not saved if filename is NULL
+ */
+void print_and_save_final_matrix_3d(const char *filename, const processor_grid_3d *grid, const real *local_tab, int verbosity);
+
+
+#endif
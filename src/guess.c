@@ -0,0 +1,255 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Initial guesses of laplace_1D and laplace_2D : boundary interpolation, coarse solution, previous result
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "guess.h"
+#include "stencil.h"
+#include "io.h"
+
+
+/**
+ * Values of a matrix covering the whole square (coarse solution or previous result), of which only some rows may be stored
+ */
+typedef struct
+{
+    int rows, cols;         // dimensions of the matrix
+    int first_row;          // first row stored in values
+    const double *values;   // the stored rows, row by row
+    const real *boundary;   // values outside the matrix (EDGE_BOTTOM, EDGE_TOP, EDGE_LEFT, EDGE_RIGHT)
+} guess_source;
+
+
+/**
+ * Value (r, c) of the source, r = -1 or rows (c = -1 or cols) outside the matrix : the boundary values, their average in a corner
+ */
+static double source_value(const guess_source *source, int r, int c)
+{
+    int row_edge = (r < 0) ? EDGE_BOTTOM : (r >= source->rows) ? EDGE_TOP : -1;
+    int col_edge = (c < 0) ? EDGE_LEFT : (c >= source->cols) ? EDGE_RIGHT : -1;
+    if (row_edge >= 0 && col_edge >= 0) { return (source->boundary[row_edge] + source->boundary[col_edge])/2; }
+    if (row_edge >= 0) { return source->boundary[row_edge]; }
+    if (col_edge >= 0) { return source->boundary[col_edge]; }
+    return source->values[(size_t)(r - source->first_row)*source->cols + c];
+}
+
+
+/**
+ * Position of the value k of a matrix of N values in a matrix of M values (covering the same interval) :
+ * index of the previous value (-1 : the boundary) and fraction of the way to the next one
+ */
+static int source_position(int k, int N, int M, double *fraction)
+{
+    double position = (k+1.0)*(M+1)/(N+1) - 1;
+    int previous = (int)floor(position);
+    if (previous > M-1) { previous = M-1; }
+    *fraction = position - previous;
+    return previous;
+}
+
+
+/**
+ * Significant values of local_tab interpolated bilinearly from the source
+ */
+static void interpolate_block(const processor_grid *grid, real *local_tab, const guess_source *source)
+{
+    const block_layout *layout = &grid->layout;
+    int N = layout->global_sizes[0], nb_cols = grid->Nlocal_cols;
+    #pragma omp parallel for schedule(static) if((long)layout->sizes[0]*layout->sizes[1] >= STENCIL_MIN_PARALLEL_CELLS) // rows of the threads of alloc_matrix
+    for (int i = 0; i < layout->sizes[0]; i++)
+    {
+        double fr, fc;
+        int r = source_position(layout->starts[0] + i, N, source->rows, &fr);
+        for (int j = 0; j < layout->sizes[1]; j++)
+        {
+            int c = source_position(layout->starts[1] + j, N, source->cols, &fc);
+            double value = (1-fr)*((1-fc)*source_value(source, r, c)   + fc*source_value(source, r, c+1))
+                         +    fr *((1-fc)*source_value(source, r+1, c) + fc*source_value(source, r+1, c+1));
+            local_tab[(size_t)(i+1)*nb_cols + j+1] = (real)value;
+        }
+    }
+}
+
+
+/**
+ * INITIAL_BOUNDARY : average of the boundary values weighted by the inverse of the squared distance to each edge
+ */
+static void interpolate_boundary(const processor_grid *grid, real *local_tab, const real *boundary)
+{
+    const block_layout *layout = &grid->layout;
+    int N = layout->global_sizes[0], nb_cols = grid->Nlocal_cols;
+    #pragma omp parallel for schedule(static) if((long)layout->sizes[0]*layout->sizes[1] >= STENCIL_MIN_PARALLEL_CELLS) // rows of the threads of alloc_matrix
+    for (int i = 0; i < layout->sizes[0]; i++)
+    {
+        double y = (layout->starts[0] + i + 1.0)/(N+1); // distance to the bottom edge
+        for (int j = 0; j < layout->sizes[1]; j++)
+        {
+            double x = (layout->starts[1] + j + 1.0)/(N+1); // distance to the left edge
+            double weights[4] = {1/(y*y), 1/((1-y)*(1-y)), 1/(x*x), 1/((1-x)*(1-x))}; // bottom, top, left, right
+            double sum = 0, total = 0;
+            for (int edge = 0; edge < 4; edge++)
+            {
+                sum += weights[edge]*boundary[edge];
+                total += weights[edge];
+            }
+            local_tab[(size_t)(i+1)*nb_cols + j+1] = (real)(sum/total);
+        }
+    }
+}
+
+
+/**
+ * INITIAL_COARSE : solution of the laplace equation on a n x n matrix (SOR until the values stop changing), in values
+ */
+static void solve_coarse(double *values, int n, const real *boundary)
+{
+    int cols = n+2; // the boundary values around the matrix
+    double *u = (double*)malloc((size_t)(n+2)*cols*sizeof(double));
+    if (u == NULL) { exit(-1); } // Check if the memory has been well allocated
+    guess_source around = {n, n, 0, NULL, boundary}; // only its boundary values are read
+    for (int i = 0; i < n+2; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            int inside = (i > 0 && i <= n && j > 0 && j <= n);
+            u[(size_t)i*cols + j] = inside ? 0 : source_value(&around, i-1, j-1);
+        }
+    }
+    double scale = 0;
+    for (int edge = 0; edge < 4; edge++)
+    {
+        if (fabs(boundary[edge]) > scale) { scale = fabs(boundary[edge]); }
+    }
+
+    double omega = 2.0/(1.0+sin(M_PI/(n+1))); // optimal factor for this problem
+    for (int iter = 0; iter < 50*n; iter++)
+    {
+        double max_change = 0;
+        for (int i = 1; i <= n; i++)
+        {
+            for (int j = 1; j <= n; j++)
+            {
+                double *value = u + (size_t)i*cols + j;
+                double change = omega*(0.25*(value[-1] + value[1] + value[-cols] + value[cols]) - *value);
+                *value += change;
+                if (fabs(change) > max_change) { max_change = fabs(change); }
+            }
+        }
+        if (max_change <= 1e-7*scale) { break; } // far below the interpolation error of the coarse matrix
+    }
+    for (int i = 0; i < n; i++)
+    {
+        memcpy(values + (size_t)i*n, u + (size_t)(i+1)*cols + 1, n*sizeof(double));
+    }
+    free(u);
+}
+
+
+/**
+ * INITIAL_FILE : read the rows of the previous result needed by my block (collective), and interpolate them
+ */
+static int interpolate_file(const processor_grid *grid, real *local_tab, const solver_options *options)
+{
+    const char *filename = options->initial_file;
+    MPI_Comm comm = grid->comm;
+    int me = grid->me;
+    MPI_File file;
+    int error_code = MPI_File_open(comm, filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+    if (error_code != MPI_SUCCESS)
+    {
+        if (me == 0) { printf("ERROR: --initial-file: cannot open %s\n", filename); }
+        return -1;
+    }
+
+    // The processor 0 reads the header and shares it
+    char header[BINARY_HEADER_SIZE];
+    memset(header, 0, BINARY_HEADER_SIZE);
+    if (me == 0)
+    {
+        MPI_File_read_at(file, 0, header, BINARY_HEADER_SIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    MPI_Bcast(header, BINARY_HEADER_SIZE, MPI_BYTE, 0, comm);
+    int32_t values[3]; // version, rows, columns
+    memcpy(values, header+4, sizeof(values));
+    if (memcmp(header, "LAPL", 4) != 0 || (values[0] != 1 && values[0] != 2) || values[1] <= 0 || values[2] <= 0)
+    {
+        if (me == 0) { printf("ERROR: --initial-file: %s is not a binary result file (--output-format binary)\n", filename); }
+        MPI_File_close(&file);
+        return -1;
+    }
+    int rows = values[1], cols = values[2], value_size = (values[0] == 2) ? 8 : 4; // the values of both precisions are read
+
+    // Rows of the previous result around my block
+    const block_layout *layout = &grid->layout;
+    double fraction;
+    int first_row = source_position(layout->starts[0], layout->global_sizes[0], rows, &fraction);
+    int last_row = source_position(layout->starts[0] + layout->sizes[0]-1, layout->global_sizes[0], rows, &fraction) + 1;
+    if (first_row < 0) { first_row = 0; }
+    if (last_row > rows-1) { last_row = rows-1; }
+    size_t nb_values = (size_t)(last_row - first_row + 1)*cols;
+    char *bytes = (char*)malloc(nb_values*value_size);
+    double *rows_values = (double*)malloc(nb_values*sizeof(double));
+    if (bytes == NULL || rows_values == NULL) { exit(-1); } // Check if the memory has been well allocated
+    MPI_Datatype value_type = (value_size == 8) ? MPI_DOUBLE : MPI_FLOAT, row;
+    MPI_Type_contiguous(cols, value_type, &row); // a count of rows, not of bytes (more than 2^31 bytes for large files)
+    MPI_Type_commit(&row);
+    MPI_File_set_view(file, BINARY_HEADER_SIZE + (MPI_Offset)first_row*cols*value_size, value_type, value_type, "native", MPI_INFO_NULL);
+    error_code = MPI_File_read_all(file, bytes, last_row - first_row + 1, row, MPI_STATUS_IGNORE);
+    MPI_Type_free(&row);
+    MPI_File_close(&file);
+    int failed = (error_code != MPI_SUCCESS);
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, comm);
+    if (failed)
+    {
+        if (me == 0) { printf("ERROR: --initial-file: cannot read the %d x %d values of %s\n", rows, cols, filename); }
+        free(bytes);
+        free(rows_values);
+        return -1;
+    }
+    for (size_t k = 0; k < nb_values; k++)
+    {
+        if (value_size == 8) { double value; memcpy(&value, bytes + 8*k, 8); rows_values[k] = value; }
+        else                 { float value;  memcpy(&value, bytes + 4*k, 4); rows_values[k] = value; }
+    }
+
+    guess_source source = {rows, cols, first_row, rows_values, options->boundary};
+    interpolate_block(grid, local_tab, &source);
+    free(bytes);
+    free(rows_values);
+    return 0;
+}
+
+
+int set_initial_guess(const processor_grid *grid, real *local_tab, const solver_options *options)
+{
+    if (options->initial == INITIAL_BOUNDARY)
+    {
+        interpolate_boundary(grid, local_tab, options->boundary);
+    }
+    else if (options->initial == INITIAL_COARSE)
+    {
+        int N = grid->layout.global_sizes[0];
+        int n = (N < GUESS_COARSE_SIZE) ? N : GUESS_COARSE_SIZE;
+        double *coarse = (double*)malloc((size_t)n*n*sizeof(double));
+        if (coarse == NULL) { exit(-1); } // Check if the memory has been well allocated
+        solve_coarse(coarse, n, options->boundary); // the same on all the processors
+        guess_source source = {n, n, 0, coarse, options->boundary};
+        interpolate_block(grid, local_tab, &source);
+        free(coarse);
+    }
+    else if (options->initial == INITIAL_FILE)
+    {
+        return interpolate_file(grid, local_tab, options);
+    }
+    return 0;
+}
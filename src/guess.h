@@ -0,0 +1,39 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Initial guesses of laplace_1D and laplace_2D closer to the solution than a constant value
+
+    INITIAL_BOUNDARY    interpolation of the boundary values : the average of the values of the 4 edges, weighted by the inverse
+                        of the squared distance to each edge (the value of an edge next to it, the average of the 4 at the centre)
+    INITIAL_COARSE      solution of the same problem on a coarse matrix of at most GUESS_COARSE_SIZE x GUESS_COARSE_SIZE values
+                        (SOR, by each processor : no communication), interpolated on the matrix
+    INITIAL_FILE        a previous result (binary file of io.h, any number of rows and columns) interpolated on the matrix :
+                        each processor reads the rows around its block
+
+The matrices of another size cover the same square : the value (i, j) of a N x N matrix is at ((i+1)/(N+1), (j+1)/(N+1)),
+the boundary values at 0 and 1, and the values are interpolated bilinearly (with the boundary values of this run outside
+the coarse or previous matrix). A previous result of the same size is copied as it is.
+
+----------------------------------------------------------------------
+*/
+
+#ifndef GUESS_H
+#define GUESS_H
+
+#include "precision.h"
+#include "options.h"
+#include "grid.h"
+
+#define GUESS_COARSE_SIZE 127   // rows and columns of the coarse matrix of INITIAL_COARSE (N if it is smaller)
+
+
+/**
+ * Set the significant values of local_tab to the initial guess of options->initial, if it is INITIAL_BOUNDARY, INITIAL_COARSE
+ * or INITIAL_FILE (collective) : the other guesses and the adjacent values are the ones of initialize_local_matrix (grid.h).
+ * Returns 0 on success, -1 if the file of INITIAL_FILE cannot be read (the processor 0 prints the error)
+ */
+int set_initial_guess(const processor_grid *grid, real *local_tab, const solver_options *options);
+
+
+#endif
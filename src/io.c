@@ -0,0 +1,290 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Parallel binary output and checkpoints (MPI-IO), shared by all the decompositions
+
+No processor gathers the whole matrix : the file view of each processor is the subarray of its block
+in the whole matrix, and the memory datatype extracts the significant values of its local matrix.
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "io.h"
+#include "timers.h"
+
+
+/**
+ * Print the MPI error message on the processor 0 and return -1
+ */
+static int io_error(MPI_Comm comm, const char *filename, const char *step, int error_code)
+{
+    int me, length;
+    char message[MPI_MAX_ERROR_STRING];
+    MPI_Comm_rank(comm, &me);
+    MPI_Error_string(error_code, message, &length);
+    if (me == 0) { printf("ERROR: %s %s: %s\n", step, filename, message); }
+    return -1;
+}
+
+
+/**
+ * Rows of the file of the whole matrix (all the dimensions but the last one) : the header gives rows x columns
+ */
+static int file_rows(const block_layout *layout)
+{
+    int rows = 1;
+    for (int d = 0; d < layout->ndims-1; d++)
+    {
+        rows *= layout->global_sizes[d];
+    }
+    return rows;
+}
+
+
+/**
+ * Number of significant values of my block
+ */
+static int block_values(const block_layout *layout)
+{
+    int values = 1;
+    for (int d = 0; d < layout->ndims; d++)
+    {
+        values *= layout->sizes[d];
+    }
+    return values;
+}
+
+
+/**
+ * File view of my block in the whole matrix, after a header of displacement bytes
+ */
+static void set_block_view(MPI_File file, MPI_Offset displacement, const block_layout *layout)
+{
+    MPI_Datatype file_block;
+    MPI_Type_create_subarray(layout->ndims, (int*)layout->global_sizes, (int*)layout->sizes, (int*)layout->starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &file_block);
+    MPI_Type_commit(&file_block);
+    MPI_File_set_view(file, displacement, LAPLACE_MPI_REAL, file_block, "native", MPI_INFO_NULL);
+    MPI_Type_free(&file_block);
+}
+
+
+int write_binary_matrix(const char *filename, MPI_Comm comm, const real *local_tab, const block_layout *layout, int with_header)
+{
+    int me;
+    MPI_Comm_rank(comm, &me);
+
+    MPI_File file;
+    int error_code = MPI_File_open(comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+    if (error_code != MPI_SUCCESS) { return io_error(comm, filename, "matrix_save: MPI_File_open", error_code); }
+    MPI_File_set_size(file, 0); // an older and bigger file is truncated
+
+    MPI_Offset displacement = 0;
+    if (with_header)
+    {
+        if (me == 0)
+        {
+            char header[BINARY_HEADER_SIZE];
+            int32_t values[3] = {FILE_VERSION, file_rows(layout), layout->global_sizes[layout->ndims-1]}; // version, rows, columns
+            memcpy(header, "LAPL", 4);
+            memcpy(header+4, values, sizeof(values));
+            MPI_File_write_at(file, 0, header, BINARY_HEADER_SIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+        }
+        displacement = BINARY_HEADER_SIZE;
+    }
+
+    // Position of my block in the file, and of its significant values in my local matrix
+    MPI_Datatype memory_block;
+    MPI_Type_create_subarray(layout->ndims, (int*)layout->local_sizes, (int*)layout->sizes, (int*)layout->local_starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &memory_block);
+    MPI_Type_commit(&memory_block);
+
+    set_block_view(file, displacement, layout);
+    error_code = MPI_File_write_all(file, (void*)local_tab, 1, memory_block, MPI_STATUS_IGNORE);
+
+    MPI_Type_free(&memory_block);
+    MPI_File_close(&file);
+
+    if (error_code != MPI_SUCCESS) { return io_error(comm, filename, "matrix_save: MPI_File_write_all", error_code); }
+    return 0;
+}
+
+
+void init_checkpoint(checkpoint_writer *checkpoint, const char *filename, MPI_Comm comm, const block_layout *layout)
+{
+    checkpoint->filename = filename;
+    checkpoint->tmp_filename = NULL;
+    checkpoint->comm = comm;
+    MPI_Comm_rank(comm, &checkpoint->me);
+    checkpoint->layout = *layout;
+    checkpoint->buffer = NULL;
+    checkpoint->req = MPI_REQUEST_NULL;
+    checkpoint->iteration = 0;
+    checkpoint->error = 0;
+    checkpoint->last_time = MPI_Wtime();
+    if (filename == NULL) { return; }
+
+    checkpoint->tmp_filename = (char*)malloc(strlen(filename)+5);
+    checkpoint->buffer = (real*)malloc((size_t)block_values(layout)*sizeof(real));
+    if (checkpoint->tmp_filename == NULL || checkpoint->buffer == NULL) { exit(-1); } // Check if the memory has been well allocated
+    sprintf(checkpoint->tmp_filename, "%s.tmp", filename);
+}
+
+
+int start_checkpoint(checkpoint_writer *checkpoint, const real *local_tab, int iteration, double error)
+{
+    if (checkpoint->filename == NULL) { return 0; }
+    if (finish_checkpoint(checkpoint) != 0) { return -1; } // one checkpoint in flight at most : a single copy of the values
+    checkpoint->last_time = MPI_Wtime();
+
+    // Copy of my significant values : local_tab is modified by the next iterations during the write
+    const block_layout *layout = &checkpoint->layout;
+    int d = layout->ndims-2; // rows and columns of a plane (a single plane in 2D)
+    int nb_planes = (layout->ndims == 3) ? layout->sizes[0] : 1;
+    timer_phase previous = timer_switch(TIMER_COPY);
+    for (int p = 0; p < nb_planes; p++)
+    {
+        size_t local_plane = (layout->ndims == 3) ? (size_t)(layout->local_starts[0]+p)*layout->local_sizes[1]*layout->local_sizes[2] : 0;
+        for (int i = 0; i < layout->sizes[d]; i++)
+        {
+            memcpy(checkpoint->buffer + ((size_t)p*layout->sizes[d] + i)*layout->sizes[d+1],
+                   local_tab + local_plane + (size_t)(layout->local_starts[d]+i)*layout->local_sizes[d+1] + layout->local_starts[d+1],
+                   layout->sizes[d+1]*sizeof(real));
+        }
+    }
+    timer_switch(previous);
+    checkpoint->iteration = iteration;
+    checkpoint->error = error;
+
+    int error_code = MPI_File_open(checkpoint->comm, checkpoint->tmp_filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &checkpoint->file);
+    if (error_code != MPI_SUCCESS) { return io_error(checkpoint->comm, checkpoint->tmp_filename, "checkpoint: MPI_File_open", error_code); }
+    MPI_File_set_size(checkpoint->file, 0); // an older and bigger file is truncated
+
+    set_block_view(checkpoint->file, CHECKPOINT_HEADER_SIZE, layout);
+    error_code = MPI_File_iwrite_all(checkpoint->file, checkpoint->buffer, block_values(layout), LAPLACE_MPI_REAL, &checkpoint->req); // completed by finish_checkpoint
+    if (error_code != MPI_SUCCESS)
+    {
+        MPI_File_close(&checkpoint->file);
+        return io_error(checkpoint->comm, checkpoint->tmp_filename, "checkpoint: MPI_File_iwrite_all", error_code);
+    }
+    return 0;
+}
+
+
+int checkpoint_interval_elapsed(const checkpoint_writer *checkpoint, double interval)
+{
+    if (checkpoint->filename == NULL || interval <= 0 || checkpoint->me != 0) { return 0; }
+    return (MPI_Wtime() - checkpoint->last_time >= interval);
+}
+
+
+int finish_checkpoint(checkpoint_writer *checkpoint)
+{
+    if (checkpoint->req == MPI_REQUEST_NULL) { return 0; }
+
+    int me = checkpoint->me;
+    int error_code = MPI_Wait(&checkpoint->req, MPI_STATUS_IGNORE);
+
+    // The header is written once all the values are in the file
+    MPI_File_set_view(checkpoint->file, 0, MPI_BYTE, MPI_BYTE, "native", MPI_INFO_NULL);
+    if (me == 0 && error_code == MPI_SUCCESS)
+    {
+        char header[CHECKPOINT_HEADER_SIZE];
+        int32_t values[5] = {FILE_VERSION, file_rows(&checkpoint->layout), checkpoint->layout.global_sizes[checkpoint->layout.ndims-1], checkpoint->iteration, 0}; // version, rows, columns, iteration, padding
+        memcpy(header, "LCKP", 4);
+        memcpy(header+4, values, sizeof(values));
+        memcpy(header+24, &checkpoint->error, sizeof(double));
+        error_code = MPI_File_write_at(checkpoint->file, 0, header, CHECKPOINT_HEADER_SIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&checkpoint->file);
+
+    int failed = (error_code != MPI_SUCCESS); // the previous checkpoint is kept if any processor failed
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, checkpoint->comm);
+    if (failed)
+    {
+        if (me == 0) { printf("ERROR: checkpoint: write of %s failed\n", checkpoint->tmp_filename); }
+        return -1;
+    }
+
+    if (me == 0 && rename(checkpoint->tmp_filename, checkpoint->filename) != 0) { perror("checkpoint: rename "); }
+    return 0;
+}
+
+
+void resize_checkpoint(checkpoint_writer *checkpoint, const block_layout *layout)
+{
+    finish_checkpoint(checkpoint);
+    checkpoint->layout = *layout;
+    if (checkpoint->filename == NULL) { return; }
+    free(checkpoint->buffer);
+    checkpoint->buffer = (real*)malloc((size_t)block_values(layout)*sizeof(real));
+    if (checkpoint->buffer == NULL) { exit(-1); } // Check if the memory has been well allocated
+}
+
+
+void free_checkpoint(checkpoint_writer *checkpoint)
+{
+    finish_checkpoint(checkpoint);
+    free(checkpoint->tmp_filename);
+    free(checkpoint->buffer);
+}
+
+
+int read_checkpoint(const char *filename, MPI_Comm comm, real *local_tab, const block_layout *layout, int *iteration, double *error)
+{
+    int me;
+    MPI_Comm_rank(comm, &me);
+
+    MPI_File file;
+    int error_code = MPI_File_open(comm, filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &file);
+    if (error_code != MPI_SUCCESS) { return io_error(comm, filename, "restart: MPI_File_open", error_code); }
+
+    // The processor 0 reads the header and shares it
+    char header[CHECKPOINT_HEADER_SIZE];
+    memset(header, 0, CHECKPOINT_HEADER_SIZE);
+    if (me == 0)
+    {
+        MPI_File_read_at(file, 0, header, CHECKPOINT_HEADER_SIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    MPI_Bcast(header, CHECKPOINT_HEADER_SIZE, MPI_BYTE, 0, comm);
+
+    int32_t values[5]; // version, rows, columns, iteration, padding
+    memcpy(values, header+4, sizeof(values));
+    if (memcmp(header, "LCKP", 4) != 0 || (values[0] != 1 && values[0] != 2))
+    {
+        if (me == 0) { printf("ERROR: restart: %s is not a checkpoint\n", filename); }
+        MPI_File_close(&file);
+        return -1;
+    }
+    if (values[0] != FILE_VERSION)
+    {
+        if (me == 0) { printf("ERROR: restart: the checkpoint %s has float%d values, but this build uses float%d values\n", filename, values[0] == 2 ? 64 : 32, (int)(8*sizeof(real))); }
+        MPI_File_close(&file);
+        return -1;
+    }
+    if (values[1] != file_rows(layout) || values[2] != layout->global_sizes[layout->ndims-1])
+    {
+        if (me == 0) { printf("ERROR: restart: the checkpoint %s is a %d x %d matrix, but we have N = %d\n", filename, values[1], values[2], layout->global_sizes[0]); }
+        MPI_File_close(&file);
+        return -1;
+    }
+    *iteration = values[3];
+    memcpy(error, header+24, sizeof(double));
+
+    MPI_Datatype memory_block;
+    MPI_Type_create_subarray(layout->ndims, (int*)layout->local_sizes, (int*)layout->sizes, (int*)layout->local_starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &memory_block);
+    MPI_Type_commit(&memory_block);
+
+    set_block_view(file, CHECKPOINT_HEADER_SIZE, layout);
+    error_code = MPI_File_read_all(file, local_tab, 1, memory_block, MPI_STATUS_IGNORE);
+
+    MPI_Type_free(&memory_block);
+    MPI_File_close(&file);
+
+    if (error_code != MPI_SUCCESS) { return io_error(comm, filename, "restart: MPI_File_read_all", error_code); }
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Parallel binary output and checkpoints (MPI-IO), shared by all the decompositions
+
+Binary file format ("binary" output) :
+    header of 16 bytes : "LAPL" (4 characters), version (int32), number of rows (int32), number of columns (int32)
+    then rows x columns values, row by row, the row 0 first (native byte order) :
+    float32 values (version 1), or float64 values (version 2, double precision build, see precision.h)
+The "raw" output only contains the values.
+A 3D matrix (laplace_3D) is stored as the 2D matrix of its N*N rows of N values : the planes one after the other.
+
+Checkpoint file format :
+    header of 32 bytes : "LCKP" (4 characters), version (int32, 1 or 2 as the binary output), number of rows (int32), number of columns (int32),
+    iteration (int32), padding (int32), error of the last convergence check (float64)
+    then the significant values of the whole matrix, as in the binary output
+The checkpoint is written in FILE.tmp, the header last, and FILE.tmp replaces FILE once it is complete :
+a run stopped during a write keeps the previous checkpoint. As the values are stored for the whole matrix,
+a run can restart with another number of processors (but not with another size of the values).
+
+----------------------------------------------------------------------
+*/
+
+#ifndef IO_H
+#define IO_H
+
+#include "mpi.h"
+#include "precision.h"
+
+#define BINARY_HEADER_SIZE 16
+#define CHECKPOINT_HEADER_SIZE 32
+#define FILE_VERSION (sizeof(real) == 8 ? 2 : 1) // version of the files : size of the values
+
+
+/**
+ * Position of the significant values of a local matrix in the whole matrix
+ * 2D (ndims = 2) : rows and columns ; 3D (ndims = 3) : planes, rows and columns
+ */
+typedef struct
+{
+    int ndims;              // number of dimensions of the matrix (2 or 3)
+    int global_sizes[3];    // rows and columns of the whole matrix
+    int sizes[3];           // SIGNIFICANT rows and columns of the block
+    int starts[3];          // position of the block in the whole matrix (first row, first column)
+    int local_sizes[3];     // rows and columns of the local matrix (ADJACENT values included)
+    int local_starts[3];    // position of the first SIGNIFICANT value in the local matrix
+} block_layout;
+
+
+/**
+ * Write the whole matrix in a binary file : each processor of comm writes its own block, with a collective MPI_File_write_all.
+ * with_header = 1 writes the 16 bytes header first ("binary" output), 0 only the values ("raw" output).
+ * Returns 0 on success, -1 otherwise (the processor 0 prints the error).
+ */
+int write_binary_matrix(const char *filename, MPI_Comm comm, const real *local_tab, const block_layout *layout, int with_header);
+
+
+/**
+ * Checkpoint written in the background : the significant values are copied in buffer, so that the solver
+ * can go on updating its local matrix while MPI_File_iwrite_all writes them
+ */
+typedef struct
+{
+    const char *filename;       // name of the checkpoint (NULL : no checkpoint)
+    char *tmp_filename;         // filename.tmp, written before it replaces filename
+    MPI_Comm comm;
+    int me;                     // my rank in comm
+    block_layout layout;        // position of my block in the whole matrix
+    real *buffer;              // copy of my significant values, being written
+    MPI_File file;
+    MPI_Request req;            // write in flight (MPI_REQUEST_NULL : none)
+    int iteration;              // iteration and error saved in the header of the checkpoint in flight
+    double error;
+    double last_time;           // MPI_Wtime() of the last checkpoint (or of the initialization)
+} checkpoint_writer;
+
+
+/**
+ * Prepare the checkpoints of the local matrices described by layout in filename (nothing is written if filename is NULL)
+ */
+void init_checkpoint(checkpoint_writer *checkpoint, const char *filename, MPI_Comm comm, const block_layout *layout);
+
+/**
+ * Start to write the significant values of local_tab, after iteration iterations (collective).
+ * The checkpoint in flight, if any, is completed first.
+ * Returns 0 on success, -1 otherwise (the processor 0 prints the error)
+ */
+int start_checkpoint(checkpoint_writer *checkpoint, const real *local_tab, int iteration, double error);
+
+/**
+ * Returns 1 on the processor 0 if the last checkpoint is older than interval seconds (0 : never), 0 otherwise.
+ * The result must be shared (added to a reduction) so that all the processors start the checkpoint together.
+ */
+int checkpoint_interval_elapsed(const checkpoint_writer *checkpoint, double interval);
+
+/**
+ * Complete the checkpoint in flight, if any : wait for the values, write the header and rename FILE.tmp to FILE (collective).
+ * Returns 0 on success, -1 otherwise (the processor 0 prints the error)
+ */
+int finish_checkpoint(checkpoint_writer *checkpoint);
+
+/**
+ * Complete the checkpoint in flight, and prepare the next ones for the new block layout of my local matrix (load balancing)
+ */
+void resize_checkpoint(checkpoint_writer *checkpoint, const block_layout *layout);
+
+/**
+ * Complete the checkpoint in flight and release the buffers
+ */
+void free_checkpoint(checkpoint_writer *checkpoint);
+
+/**
+ * Read a checkpoint written by a run on the same matrix dimension, possibly with another number of processors (collective) :
+ * the significant values of local_tab are replaced by the ones of my block, the adjacent values are not modified.
+ * Returns 0 on success, -1 otherwise (the processor 0 prints the error)
+ */
+int read_checkpoint(const char *filename, MPI_Comm comm, real *local_tab, const block_layout *layout, int *iteration, double *error);
+
+
+#endif
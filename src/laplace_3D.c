@@ -0,0 +1,47 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+V3 : 3D equation (7-point stencil) on a N x N x N matrix, using a 3D decomposition (Px x Py x Pz boxes)
+
+*****
+To run and compile the code:
+$ mpicc -O2 -o laplace_3D laplace_3D.c driver3d.c solver3d.c grid3d.c driver.c solver.c multigrid.c grid.c stencil.c options.c io.c timers.c bench.c affinity.c offload.c balance.c batch.c output.c guess.c norms.c convergence.c -lm
+$ mpirun -np [nb of processors] ./laplace_3D [options] [cubic matrix dimension]
+Double precision build, or float values with double precision updates (precision.h) : add -DLAPLACE_DOUBLE or -DLAPLACE_DOUBLE_CALC to mpicc
+
+Examples:
+$ mpirun -np 8 ./laplace_3D 6
+$ mpirun -np 4 ./laplace_3D --check-every 10 --async-check 12
+$ mpirun -np 8 ./laplace_3D --tolerance 1e-4 --max-iter 50000 --front 1 --initial 0 12
+$ mpirun -np 8 ./laplace_3D --method sor --tolerance 1e-4 --verbosity 1 --log-every 100 100
+$ mpirun -np 8 ./laplace_3D --verbosity 1 --output-format binary --output result.bin 200
+$ mpirun -np 8 ./laplace_3D --verbosity 1 --checkpoint run.ckpt --checkpoint-every 1000 --max-iter 10000 200
+$ mpirun -np 12 ./laplace_3D --verbosity 1 --checkpoint run.ckpt --checkpoint-every 1000 --restart 200
+
+Any number of processors can be used : they are organized in a grid as cubic as possible (MPI_Dims_create),
+and the matrix dimension does not need to be a multiple of the number of processors in each dimension.
+The faces of the matrix are --front and --back (first and last planes), --bottom and --top (rows), --left and --right (columns).
+Only the jacobi, gauss-seidel and sor methods are available (no multigrid, cg, deep halo or cache blocking).
+
+Hybrid MPI+OpenMP mode (a few processors per node, the planes shared between OpenMP threads):
+$ mpicc -O2 -fopenmp -o laplace_3D laplace_3D.c driver3d.c solver3d.c grid3d.c driver.c solver.c multigrid.c grid.c stencil.c options.c io.c timers.c bench.c affinity.c offload.c balance.c batch.c output.c guess.c norms.c convergence.c -lm
+$ OMP_NUM_THREADS=4 mpirun -np 2 ./laplace_3D 12
+
+Note : for performance evaluation, use --verbosity 0 : nothing is printed during the computation,
+and the final matrix is neither gathered nor saved. --verbosity 1 only prints the errors (see --log-every) and saves the file.
+
+----------------------------------------------------------------------
+*/
+
+
+#include "driver.h"
+
+
+/**
+ * Main function
+ */
+int main( int argc, char *argv[] )
+{
+    return laplace_main_3d(argc, argv, "laplace_3D");
+}
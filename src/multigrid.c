@@ -0,0 +1,400 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Geometric multigrid (V-cycle), as a method (laplace) and as the preconditioner of the conjugate gradient
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "multigrid.h"
+#include "stencil.h"
+#include "timers.h"
+#include "affinity.h"
+
+
+#define MG_COARSEST_SIZE 4      // the coarsest level has at most MG_COARSEST_SIZE rows and columns
+#define MG_SMOOTHING_SWEEPS 2   // red-black Gauss-Seidel sweeps before and after the coarse correction
+#define MG_COARSEST_SWEEPS 20   // red-black Gauss-Seidel sweeps on the coarsest level
+
+
+/**
+ * Give the first index and the size of the part number index on the coarsening level level :
+ * the coarse points of a part are the points of odd index of the fine part
+ */
+static void level_block_range(int N, int nb_parts, int index, int level, int *first, int *size)
+{
+    block_range(N, nb_parts, index, first, size);
+    for (int l = 0; l < level; l++)
+    {
+        int last = *first + *size; // first point of the next part
+        *first = *first/2;
+        *size = last/2 - *first;
+    }
+}
+
+
+/**
+ * Smallest part on the coarsening level level
+ */
+static int level_smallest_block(int N, int nb_parts, int level)
+{
+    int smallest = N;
+    for (int index = 0; index < nb_parts; index++)
+    {
+        int first, size;
+        level_block_range(N, nb_parts, index, level, &first, &size);
+        if (size < smallest) { smallest = size; }
+    }
+    return smallest;
+}
+
+
+/**
+ * Allocate the values of a level (set to 0) and its halo exchange on comm : u and f are given by the caller on the level 0.
+ * distance is the distance between the last row/column of the level and the boundary, in steps of the level 0 (step : step of the level)
+ */
+static void init_mg_level(mg_level *level, MPI_Comm comm, int global_size, int starts[2], int sizes[2], int distance, int step, real *u, real *f)
+{
+    int nb_rows = sizes[0]+2, nb_cols = sizes[1]+2;
+    level->global_size = global_size;
+    for (int k = 0; k < 2; k++)
+    {
+        level->starts[k] = starts[k];
+        level->sizes[k] = sizes[k];
+    }
+    level->agglomerated = 0;
+    level->ghost = fmin(1.0, (real)(step - distance)/distance); // linear extrapolation of the values to 0 on the boundary, at most 1 :
+                                                                  // the sweeps use the ghost of the previous values, a larger one would be unstable
+    level->u = (u != NULL) ? u : alloc_matrix(nb_rows, nb_cols);
+    level->f = (u != NULL) ? f : alloc_matrix(nb_rows, nb_cols);
+    level->r = alloc_matrix(nb_rows, nb_cols);
+    level->e = alloc_matrix(nb_rows, nb_cols);
+    if (level->u == NULL || (u == NULL && level->f == NULL) || level->r == NULL || level->e == NULL) { exit(-1); } // Check if the memory has been well allocated
+    init_halo_exchange(&level->halo, comm, nb_rows, nb_cols);
+}
+
+
+void init_multigrid(multigrid *mg, MPI_Comm cart_comm, const block_layout *layout, real *local_tab, real *rhs)
+{
+    int NPROC, dims[2], periods[2], coords[2];
+    MPI_Comm_size(cart_comm, &NPROC);
+    MPI_Cart_get(cart_comm, 2, dims, periods, coords);
+    MPI_Comm_rank(cart_comm, &mg->me);
+    mg->comm = cart_comm;
+    mg->self_comm = MPI_COMM_NULL;
+    mg->block = MPI_DATATYPE_NULL;
+    mg->gathered_blocks = NULL;
+
+    int N = layout->global_sizes[0];
+    int l = 0;
+    int global_size = N;         // dimension of the matrix of the level l
+    int step = 1, distance = 1;  // step of the level l and distance between its last point and the boundary
+    init_mg_level(&mg->levels[0], cart_comm, N, (int*)layout->starts, (int*)layout->sizes, distance, step, local_tab, rhs);
+
+    // Levels distributed on all the processors, until one of the blocks is too small
+    while (global_size > MG_COARSEST_SIZE && l < MG_MAX_LEVELS-2)
+    {
+        distance += (global_size%2) * step;
+        step *= 2;
+        global_size /= 2;
+
+        int starts[2], sizes[2];
+        for (int k = 0; k < 2; k++)
+        {
+            level_block_range(N, dims[k], coords[k], l+1, &starts[k], &sizes[k]);
+        }
+        init_mg_level(&mg->levels[++l], cart_comm, global_size, starts, sizes, distance, step, NULL, NULL);
+        if (NPROC > 1 && (level_smallest_block(N, dims[0], l) < MG_MIN_BLOCK || level_smallest_block(N, dims[1], l) < MG_MIN_BLOCK))
+        {
+            mg->levels[l].agglomerated = 1;
+            break;
+        }
+    }
+
+    if (mg->levels[l].agglomerated)
+    {
+        mg_level *level = &mg->levels[l];
+        int local_sizes[2] = {level->sizes[0]+2, level->sizes[1]+2};
+        int local_starts[2] = {1, 1};
+        MPI_Type_create_subarray(2, local_sizes, level->sizes, local_starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &mg->block);
+        MPI_Type_commit(&mg->block);
+
+        if (mg->me == 0) // the processor 0 solves the next levels alone, on the whole matrix of the agglomerated level
+        {
+            int self_dims[2] = {1, 1}, self_periods[2] = {0, 0}, zero[2] = {0, 0};
+            int whole[2] = {global_size, global_size};
+            MPI_Cart_create(MPI_COMM_SELF, 2, self_dims, self_periods, 0, &mg->self_comm);
+            init_mg_level(&mg->levels[++l], mg->self_comm, global_size, zero, whole, distance, step, NULL, NULL);
+
+            mg->gathered_blocks = (MPI_Datatype*)malloc(NPROC*sizeof(MPI_Datatype));
+            if (mg->gathered_blocks == NULL) { exit(-1); } // Check if the memory has been well allocated
+            int gathered_sizes[2] = {global_size+2, global_size+2};
+            for (int i = 0; i < NPROC; i++)
+            {
+                int i_coords[2], starts[2], sizes[2];
+                MPI_Cart_coords(cart_comm, i, 2, i_coords);
+                for (int k = 0; k < 2; k++)
+                {
+                    level_block_range(N, dims[k], i_coords[k], l-1, &starts[k], &sizes[k]);
+                    starts[k] += 1; // first SIGNIFICANT value
+                }
+                MPI_Type_create_subarray(2, gathered_sizes, sizes, starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &mg->gathered_blocks[i]);
+                MPI_Type_commit(&mg->gathered_blocks[i]);
+            }
+
+            while (global_size > MG_COARSEST_SIZE && l < MG_MAX_LEVELS-1)
+            {
+                distance += (global_size%2) * step;
+                step *= 2;
+                global_size /= 2;
+                whole[0] = whole[1] = global_size;
+                init_mg_level(&mg->levels[++l], mg->self_comm, global_size, zero, whole, distance, step, NULL, NULL);
+            }
+        }
+    }
+    mg->nb_levels = l+1;
+}
+
+
+void free_multigrid(multigrid *mg)
+{
+    int NPROC;
+    MPI_Comm_size(mg->comm, &NPROC);
+    for (int l = 0; l < mg->nb_levels; l++)
+    {
+        if (l > 0)
+        {
+            free(mg->levels[l].u);
+            free(mg->levels[l].f);
+        }
+        free(mg->levels[l].r);
+        free(mg->levels[l].e);
+        free_halo_exchange(&mg->levels[l].halo);
+    }
+    if (mg->block != MPI_DATATYPE_NULL) { MPI_Type_free(&mg->block); }
+    if (mg->gathered_blocks != NULL)
+    {
+        for (int i = 0; i < NPROC; i++)
+        {
+            MPI_Type_free(&mg->gathered_blocks[i]);
+        }
+        free(mg->gathered_blocks);
+    }
+    if (mg->self_comm != MPI_COMM_NULL) { MPI_Comm_free(&mg->self_comm); }
+}
+
+
+/**
+ * Refresh the adjacent data of tab : exchange with the other processors of the level, then extrapolation after the last row
+ * and the last column of the matrix (ghost, the adjacent values before the first row/column stay at 0)
+ */
+static void mg_update(mg_level *level, real *tab)
+{
+    update_matrix(&level->halo, tab);
+    if (level->ghost == 0) { return; }
+
+    int nb_cols = level->sizes[1]+2;
+    if (level->starts[0] + level->sizes[0] == level->global_size) // last row of the matrix
+    {
+        for (int j = 1; j <= level->sizes[1]; j++)
+        {
+            tab[j+(level->sizes[0]+1)*nb_cols] = -level->ghost * tab[j+level->sizes[0]*nb_cols];
+        }
+    }
+    if (level->starts[1] + level->sizes[1] == level->global_size) // last column of the matrix
+    {
+        for (int i = 1; i <= level->sizes[0]; i++)
+        {
+            tab[(level->sizes[1]+1)+i*nb_cols] = -level->ghost * tab[level->sizes[1]+i*nb_cols];
+        }
+    }
+}
+
+
+/**
+ * Red-black Gauss-Seidel sweeps on a level : the adjacent data of u are refreshed before each colour.
+ * The sweeps after the coarse correction update the colours in the reverse order (reverse = 1), so that the V-cycle is symmetric
+ * (a valid preconditioner of the conjugate gradient).
+ */
+static void mg_smooth(mg_level *level, int nb_sweeps, int reverse)
+{
+    int nb_cols = level->sizes[1]+2;
+    for (int sweep = 0; sweep < nb_sweeps; sweep++)
+    {
+        for (int color = 0; color < 2; color++)
+        {
+            int parity = (color + reverse + level->starts[0] + level->starts[1]) & 1; // the local cell (i,j) is the cell (starts[0]+i-1, starts[1]+j-1) of the level
+            mg_update(level, level->u);
+            stencil_relax_color(level->u, level->f, 1, level->sizes[0], 1, level->sizes[1], nb_cols, parity, 1.0f, 0);
+        }
+    }
+}
+
+
+/**
+ * Residual of a level : r = f - (4*u - neighbors), on the SIGNIFICANT values
+ */
+static void mg_residual(mg_level *level)
+{
+    int nb_cols = level->sizes[1]+2;
+    mg_update(level, level->u);
+    for (int i = 1; i <= level->sizes[0]; i++)
+    {
+        for (int j = 1; j <= level->sizes[1]; j++)
+        {
+            const real *u = level->u + j + i*nb_cols;
+            real source = (level->f != NULL) ? level->f[j+i*nb_cols] : 0.0f;
+            level->r[j+i*nb_cols] = source + (u[nb_cols] + u[-nb_cols] + u[-1] + u[1]) - 4.0f*u[0];
+        }
+    }
+}
+
+
+/**
+ * Restriction of the residual of a level to the right-hand side of the coarse level (half weighting : 1/2 for the point, 1/8 for
+ * each neighbor). The coarse equation has a step twice larger, so its right-hand side is 4 times the restricted residual.
+ * The correction starts at 0.
+ */
+static void mg_restrict(mg_level *level, mg_level *coarse)
+{
+    int nb_cols = level->sizes[1]+2;
+    int coarse_cols = coarse->sizes[1]+2;
+    update_matrix(&level->halo, level->r); // the residual is 0 outside the matrix
+    for (int I = 0; I < coarse->sizes[0]; I++)
+    {
+        int i = 2*(coarse->starts[0]+I) + 1 - level->starts[0] + 1; // fine point of the coarse point, in my local matrix
+        for (int J = 0; J < coarse->sizes[1]; J++)
+        {
+            int j = 2*(coarse->starts[1]+J) + 1 - level->starts[1] + 1;
+            const real *r = level->r + j + i*nb_cols;
+            coarse->f[(J+1)+(I+1)*coarse_cols] = 2.0f*r[0] + 0.5f*(r[nb_cols] + r[-nb_cols] + r[-1] + r[1]);
+        }
+    }
+    memset(coarse->u, 0, (coarse->sizes[0]+2)*coarse_cols*sizeof(real));
+}
+
+
+/**
+ * Coarse point of the fine point g (0-based index in the matrix of the level) : the coarse point itself (odd g),
+ * or the previous one (even g, between the coarse points g/2-1 and g/2), as an index of the local matrix of the coarse level
+ */
+static inline int coarse_index(int g, int coarse_start)
+{
+    return (g%2 == 1) ? (g-1)/2 - coarse_start + 1 : g/2 - 1 - coarse_start + 1;
+}
+
+
+/**
+ * Prolongation of the coarse correction (bilinear interpolation) in two steps, as the corners of the matrices are not exchanged :
+ * the fine points on a coarse row or column are interpolated from 1 or 2 coarse points, then the other ones from their 4 neighbors
+ */
+static void mg_prolongate(mg_level *coarse, mg_level *level)
+{
+    int nb_cols = level->sizes[1]+2;
+    int coarse_cols = coarse->sizes[1]+2;
+    mg_update(coarse, coarse->u);
+
+    for (int i = 1; i <= level->sizes[0]; i++)
+    {
+        int gi = level->starts[0]+i-1;
+        int I = coarse_index(gi, coarse->starts[0]);
+        for (int j = 1; j <= level->sizes[1]; j++)
+        {
+            int gj = level->starts[1]+j-1;
+            int J = coarse_index(gj, coarse->starts[1]);
+            const real *c = coarse->u + J + I*coarse_cols;
+            if (gi%2 == 1 && gj%2 == 1)      { level->e[j+i*nb_cols] = c[0]; }
+            else if (gi%2 == 1)              { level->e[j+i*nb_cols] = 0.5f*(c[0] + c[1]); }
+            else if (gj%2 == 1)              { level->e[j+i*nb_cols] = 0.5f*(c[0] + c[coarse_cols]); }
+        }
+    }
+
+    mg_update(level, level->e);
+    for (int i = 1; i <= level->sizes[0]; i++)
+    {
+        int gi = level->starts[0]+i-1;
+        for (int j = 1; j <= level->sizes[1]; j++)
+        {
+            int gj = level->starts[1]+j-1;
+            real *e = level->e + j + i*nb_cols;
+            if (gi%2 == 0 && gj%2 == 0) { e[0] = 0.25f*(e[nb_cols] + e[-nb_cols] + e[-1] + e[1]); }
+        }
+    }
+    for (int i = 1; i <= level->sizes[0]; i++)
+    {
+        for (int j = 1; j <= level->sizes[1]; j++)
+        {
+            level->u[j+i*nb_cols] += level->e[j+i*nb_cols];
+        }
+    }
+}
+
+
+void multigrid_vcycle(multigrid *mg, int l)
+{
+    mg_level *level = &mg->levels[l];
+
+    if (level->agglomerated)
+    {
+        int NPROC;
+        MPI_Comm_size(mg->comm, &NPROC);
+        MPI_Request req, *reqs = NULL;
+        timer_phase previous = timer_switch(TIMER_HALO_WAIT); // the other processors wait here during the coarse solve
+        mg_level *gathered = &mg->levels[l+1];
+        if (mg->me == 0)
+        {
+            reqs = (MPI_Request*)malloc(NPROC*sizeof(MPI_Request));
+            if (reqs == NULL) { exit(-1); } // Check if the memory has been well allocated
+            for (int i = 0; i < NPROC; i++)
+            {
+                MPI_Irecv(gathered->f, 1, mg->gathered_blocks[i], i, 0, mg->comm, &reqs[i]);
+            }
+        }
+        MPI_Isend(level->f, 1, mg->block, 0, 0, mg->comm, &req);
+        if (mg->me == 0)
+        {
+            MPI_Waitall(NPROC, reqs, MPI_STATUSES_IGNORE);
+            MPI_Wait(&req, MPI_STATUS_IGNORE);
+            timer_switch(previous);
+            memset(gathered->u, 0, (gathered->sizes[0]+2)*(gathered->sizes[1]+2)*sizeof(real));
+            multigrid_vcycle(mg, l+1);
+            timer_switch(TIMER_HALO_WAIT);
+            for (int i = 0; i < NPROC; i++)
+            {
+                MPI_Isend(gathered->u, 1, mg->gathered_blocks[i], i, 1, mg->comm, &reqs[i]);
+            }
+        }
+        else
+        {
+            MPI_Wait(&req, MPI_STATUS_IGNORE);
+        }
+        MPI_Recv(level->u, 1, mg->block, 0, 1, mg->comm, MPI_STATUS_IGNORE);
+        if (mg->me == 0)
+        {
+            MPI_Waitall(NPROC, reqs, MPI_STATUSES_IGNORE);
+            free(reqs);
+        }
+        timer_switch(previous);
+        return;
+    }
+
+    if (l == mg->nb_levels-1) // coarsest level
+    {
+        mg_smooth(level, MG_COARSEST_SWEEPS/2, 0);
+        mg_smooth(level, MG_COARSEST_SWEEPS/2, 1);
+        return;
+    }
+
+    mg_level *coarse = &mg->levels[l+1];
+    mg_smooth(level, MG_SMOOTHING_SWEEPS, 0);
+    mg_residual(level);
+    mg_restrict(level, coarse);
+    multigrid_vcycle(mg, l+1);
+    mg_prolongate(coarse, level);
+    mg_smooth(level, MG_SMOOTHING_SWEEPS, 1);
+}
@@ -0,0 +1,85 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Geometric multigrid (V-cycle), as a method and as the preconditioner of the conjugate gradient
+
+The unknown values are the points 1..N of a grid whose boundary values are the points 0 and N+1 (vertex-centred) :
+the points of the coarse level are the points of odd index of the fine level (0-based), so each processor keeps the coarse points
+of its own block. The level l > 0 solves 4*u - neighbors = f for the correction of the level l-1 (f : restriction of its residual,
+0 on the boundary), the level 0 is the laplace equation itself (local_tab, with the boundary values in its adjacent data).
+When N+1 is not a power of 2, the last point of a coarse level may be closer to the boundary than its step :
+its adjacent value outside the matrix is then extrapolated (ghost), so that the correction is close to 0 on the boundary.
+When the blocks become smaller than MG_MIN_BLOCK, the coarse level is gathered on the processor 0 (agglomeration),
+which goes on alone with the coarser levels, down to MG_COARSEST_SIZE.
+The smoother is the red-black Gauss-Seidel half-sweep (stencil_relax_color), with an exchange of the adjacent data before each colour.
+
+----------------------------------------------------------------------
+*/
+
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include "mpi.h"
+#include "precision.h"
+#include "io.h"
+#include "grid.h"
+
+
+#define MG_MAX_LEVELS 32
+#define MG_MIN_BLOCK 4          // a level distributed on several processors has blocks of at least MG_MIN_BLOCK rows and columns
+
+
+/**
+ * A level of the multigrid hierarchy : u, f, r and e have the dimensions of a local matrix (SIGNIFICANT values + ADJACENT values)
+ */
+typedef struct
+{
+    halo_exchange halo;         // exchange of the adjacent data between the processors of the level
+    int global_size;            // rows and columns of the matrix of the level
+    int starts[2];              // position of my block in the matrix of the level
+    int sizes[2];               // SIGNIFICANT rows and columns of my block
+    int agglomerated;           // 1 : the level is gathered on the processor 0, which solves it as the next level
+    real ghost;                // adjacent value after the last row/column = -ghost * value of the last row/column
+    real *u;                   // values (local_tab on the level 0) or correction
+    real *f;                   // right-hand side (NULL on the level 0)
+    real *r;                   // residual, scratch values
+    real *e;                   // correction interpolated from the coarse level
+} mg_level;
+
+
+/**
+ * Multigrid hierarchy : the levels after an agglomerated one only exist on the processor 0
+ */
+typedef struct
+{
+    int me;                     // my rank in comm
+    int nb_levels;              // number of levels of this processor
+    mg_level levels[MG_MAX_LEVELS];
+    MPI_Comm comm;              // grid of all the processors
+    MPI_Comm self_comm;         // 1 x 1 grid of the processor 0, for the levels after the agglomeration
+    MPI_Datatype block;         // SIGNIFICANT values of my block on the agglomerated level
+    MPI_Datatype *gathered_blocks; // processor 0 : position of the block of each processor on the level after the agglomeration
+} multigrid;
+
+
+/**
+ * Build the levels of the multigrid hierarchy : the level 0 is the block of layout, whose values are local_tab
+ * and whose right-hand side is rhs (NULL : the laplace equation).
+ * The blocks of layout must have at least MG_MIN_BLOCK rows and columns.
+ */
+void init_multigrid(multigrid *mg, MPI_Comm cart_comm, const block_layout *layout, real *local_tab, real *rhs);
+
+/**
+ * Free the levels of the multigrid hierarchy (the values and the right-hand side of the level 0 belong to the caller)
+ */
+void free_multigrid(multigrid *mg);
+
+/**
+ * V-cycle from the level l : smoothing, coarse correction (recursive), smoothing.
+ * An agglomerated level is gathered on the processor 0, which runs the V-cycle of the next levels, and the correction is scattered back.
+ */
+void multigrid_vcycle(multigrid *mg, int l);
+
+
+#endif
@@ -0,0 +1,188 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Norms of the change of the values between two iterations, with deterministic sums
+
+----------------------------------------------------------------------
+*/
+
+
+#include <string.h>
+#include <math.h>
+#include "norms.h"
+#include "stencil.h"
+
+
+static MPI_Datatype norms_type = MPI_DATATYPE_NULL; // a change_norms, created by the first reduction
+static MPI_Op norms_op = MPI_OP_NULL;
+
+
+int uses_change_norms(const solver_options *options)
+{
+    return options->norm != NORM_L2 || options->deterministic;
+}
+
+
+void clear_change_norms(change_norms *norms)
+{
+    memset(norms, 0, sizeof(change_norms));
+}
+
+
+/**
+ * Add a term to an exact sum of NORM_LIMBS+1 limbs : the bits of its mantissa above 2^-128, 32 bits per limb (the lower bits are dropped)
+ */
+static inline void add_exact(int64_t limbs[NORM_LIMBS+1], double term)
+{
+    if (term > NORM_EXACT_MAX) { term = NORM_EXACT_MAX; }
+    uint64_t bits;
+    memcpy(&bits, &term, sizeof(bits));
+    if ((bits >> 52) == 0) { return; } // zero or subnormal : lower than 2^-128
+    uint64_t mantissa = (bits & 0xFFFFFFFFFFFFFull) | (1ull << 52);
+    int shift = (int)(bits >> 52) - 1075 + 128; // position of the lowest bit of the mantissa, from 2^-128
+    if (shift < 0)
+    {
+        if (shift <= -53) { return; }
+        mantissa >>= -shift;
+        shift = 0;
+    }
+    int limb = shift >> 5, offset = shift & 31; // the mantissa shifted by offset covers 3 limbs
+    limbs[limb]   += (int64_t)((mantissa << offset) & 0xFFFFFFFF);
+    limbs[limb+1] += (int64_t)((mantissa >> (32 - offset)) & 0xFFFFFFFF);
+    limbs[limb+2] += (int64_t)((mantissa >> (32 - offset)) >> 32);
+}
+
+
+/**
+ * Carries of an exact sum : all its limbs but the top one lower than 2^32
+ */
+static void carry_exact(int64_t limbs[NORM_LIMBS])
+{
+    for (int k = 0; k < NORM_LIMBS-1; k++)
+    {
+        limbs[k+1] += limbs[k] >> 32;
+        limbs[k] &= 0xFFFFFFFF;
+    }
+}
+
+
+/**
+ * Add the norms from to the norms to
+ */
+static void merge_change_norms(change_norms *to, const change_norms *from)
+{
+    for (int s = 0; s < 2; s++)
+    {
+        to->sums[s] += from->sums[s];
+        for (int k = 0; k < NORM_LIMBS; k++)
+        {
+            to->exact[s][k] += from->exact[s][k];
+        }
+        carry_exact(to->exact[s]);
+    }
+    if (from->max_change > to->max_change) { to->max_change = from->max_change; }
+    to->checkpoint += from->checkpoint;
+}
+
+
+void add_change_norms(change_norms *norms, const real *old_tab, const real *new_tab, int first_row, int last_row,
+                      int first_col, int last_col, int nb_cols, int deterministic)
+{
+    if (first_row > last_row || first_col > last_col) { return; }
+
+    // Each thread has its own norms, merged at the end : the exact sums do not depend on the order of the merges
+    #pragma omp parallel if((long)(last_row-first_row+1)*(last_col-first_col+1) >= STENCIL_MIN_PARALLEL_CELLS)
+    {
+        change_norms mine;
+        clear_change_norms(&mine);
+        #pragma omp for schedule(static)
+        for (int i = first_row; i <= last_row; i++)
+        {
+            const real *old_row = old_tab + (size_t)i*nb_cols, *new_row = new_tab + (size_t)i*nb_cols;
+            double row_sums[2] = {0, 0}, row_max = 0;
+            int64_t row_exact[2][NORM_LIMBS+1]; // exact sums of the row : less than 2^31 terms per limb, no carry needed
+            memset(row_exact, 0, sizeof(row_exact));
+            for (int j = first_col; j <= last_col; j++)
+            {
+                double change = (double)new_row[j] - (double)old_row[j]; // the same for any decomposition (exact for float values)
+                double squared_change = change*change, squared_value = (double)new_row[j]*new_row[j];
+                row_sums[0] += squared_change;
+                row_sums[1] += squared_value;
+                if (fabs(change) > row_max) { row_max = fabs(change); }
+                if (deterministic)
+                {
+                    add_exact(row_exact[0], squared_change);
+                    add_exact(row_exact[1], squared_value);
+                }
+            }
+            change_norms row = {{row_sums[0], row_sums[1]}, row_max, 0, {{0}}};
+            for (int t = 0; t < 2; t++)
+            {
+                memcpy(row.exact[t], row_exact[t], sizeof(row.exact[t]));
+                row.exact[t][NORM_LIMBS-1] += row_exact[t][NORM_LIMBS] << 32; // the extra limb of add_exact (term of NORM_EXACT_MAX at most)
+            }
+            merge_change_norms(&mine, &row);
+        }
+        #pragma omp critical
+        merge_change_norms(norms, &mine);
+    }
+}
+
+
+/**
+ * User-defined operation of the reduction : merge the norms of in into inout
+ */
+static void merge_norms_op(void *in, void *inout, int *len, MPI_Datatype *type)
+{
+    (void)type;
+    const change_norms *from = (const change_norms*)in;
+    change_norms *to = (change_norms*)inout;
+    for (int n = 0; n < *len; n++)
+    {
+        merge_change_norms(&to[n], &from[n]);
+    }
+}
+
+
+void reduce_change_norms(const change_norms *local, change_norms *global, MPI_Comm comm, MPI_Request *request)
+{
+    if (norms_type == MPI_DATATYPE_NULL)
+    {
+        MPI_Type_contiguous((int)sizeof(change_norms), MPI_BYTE, &norms_type);
+        MPI_Type_commit(&norms_type);
+        MPI_Op_create(merge_norms_op, 1, &norms_op); // commutative : the exact sums are, the others are sums as MPI_SUM
+    }
+    if (request == NULL)
+    {
+        MPI_Allreduce(local, global, 1, norms_type, norms_op, comm);
+    }
+    else
+    {
+        MPI_Iallreduce(local, global, 1, norms_type, norms_op, comm, request);
+    }
+}
+
+
+/**
+ * Value of an exact sum in double precision (the same integer always gives the same value)
+ */
+static double exact_value(const int64_t limbs[NORM_LIMBS])
+{
+    double value = 0;
+    for (int k = 0; k < NORM_LIMBS; k++)
+    {
+        value += ldexp((double)limbs[k], 32*k - 128);
+    }
+    return value;
+}
+
+
+double change_norm(const change_norms *norms, error_norm norm, int deterministic)
+{
+    double sum_changes = deterministic ? exact_value(norms->exact[0]) : norms->sums[0];
+    double sum_values  = deterministic ? exact_value(norms->exact[1]) : norms->sums[1];
+    if (norm == NORM_MAX) { return norms->max_change; }
+    if (norm == NORM_RELATIVE && sum_values > 0) { return sqrt(sum_changes/sum_values); }
+    return sqrt(sum_changes); // NORM_L2, and NORM_RELATIVE of null values
+}
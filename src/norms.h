@@ -0,0 +1,77 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Norms of the change of the values between two iterations (--norm, --deterministic) : the error compared with the tolerance
+
+    NORM_L2         square root of the sum of the squared changes (the error of the kernels, by default)
+    NORM_MAX        largest absolute change of a value
+    NORM_RELATIVE   L2 norm of the changes divided by the L2 norm of the new values (independent of the scale of the boundary values)
+
+The three norms are computed by the same pass over the old and new values of a block, and reduced together by a single
+collective (user-defined operation) : the sums, the maximum and the checkpoint flag of the plain reduction in one message.
+
+Deterministic sums (--deterministic) : the sum of the errors of the kernels depends on the order of its additions, so on the
+number of processors, of threads and on the SIMD kernel, and the iteration of the convergence can change with them. Each squared
+term is instead truncated to a multiple of 2^-128 and added exactly to a fixed point integer of NORM_LIMBS limbs of 32 bits,
+from 2^-128 to 2^32 (the terms are clamped to NORM_EXACT_MAX) : the integer additions do not depend on their order, and the
+sums are the same for any decomposition, number of threads and reduction tree, as long as the values are (jacobi, gauss-seidel
+and sor compute the same values with any number of processors).
+
+----------------------------------------------------------------------
+*/
+
+#ifndef NORMS_H
+#define NORMS_H
+
+#include <stdint.h>
+#include "mpi.h"
+#include "precision.h"
+#include "options.h"
+
+#define NORM_LIMBS 6            // limbs of the exact sums, the limb k has the weight 2^(32k-128)
+#define NORM_EXACT_MAX 0x1p62   // largest squared term of the exact sums (larger terms are clamped)
+
+
+/**
+ * Partial norms of the change of a part of the matrix, reduced by reduce_change_norms
+ */
+typedef struct
+{
+    double sums[2];         // sum of the squared changes, sum of the squared new values
+    double max_change;      // largest absolute change
+    double checkpoint;      // > 0 : a checkpoint is needed (summed, as the checkpoint time of the plain reduction)
+    int64_t exact[2][NORM_LIMBS]; // deterministic : the two sums in fixed point (limbs lower than 2^32, after the carries)
+} change_norms;
+
+
+/**
+ * Returns 1 if the error of the options is computed by change_norms (--norm max or relative, --deterministic), 0 if it is the sum of the kernels
+ */
+int uses_change_norms(const solver_options *options);
+
+/**
+ * Reset the norms (no value)
+ */
+void clear_change_norms(change_norms *norms);
+
+/**
+ * Add the changes from old_tab to new_tab of the values (first_row..last_row, first_col..last_col) to the norms,
+ * and their exact sums if deterministic (the rows are shared between the OpenMP threads)
+ */
+void add_change_norms(change_norms *norms, const real *old_tab, const real *new_tab, int first_row, int last_row,
+                      int first_col, int last_col, int nb_cols, int deterministic);
+
+/**
+ * Reduce the norms of all the processors of comm in global (collective) : at once if request is NULL,
+ * otherwise in the background (MPI_Iallreduce, local and global unchanged until request completes)
+ */
+void reduce_change_norms(const change_norms *local, change_norms *global, MPI_Comm comm, MPI_Request *request);
+
+/**
+ * Value of a norm (NORM_L2, NORM_MAX or NORM_RELATIVE) of reduced norms, from their exact sums if deterministic
+ */
+double change_norm(const change_norms *norms, error_norm norm, int deterministic);
+
+
+#endif
@@ -0,0 +1,450 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Iterations of the 1D and 2D solvers on an accelerator (OpenMP target offload, -DLAPLACE_OFFLOAD)
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "offload.h"
+#include "solver.h"
+#include "affinity.h"
+#include "timers.h"
+#include "convergence.h"
+
+
+#if defined(LAPLACE_OFFLOAD) && defined(_OPENMP)
+
+#include <omp.h>
+#if defined(OPEN_MPI) && OPEN_MPI
+#include "mpi-ext.h" // MPIX_Query_cuda_support
+#endif
+
+
+/**
+ * Exchange of the adjacent values of a local matrix resident on the accelerator : the SIGNIFICANT rows and columns
+ * next to each neighbor are packed by a kernel in send, and the messages received in recv are unpacked by a kernel
+ * in the ADJACENT rows and columns. The neighbors are ordered as in halo_exchange : above, under, left, right.
+ */
+typedef struct
+{
+    MPI_Comm comm;              // Cartesian communicator of the grid
+    int neighbors[4];           // rank of each neighbor, MPI_PROC_NULL on the edges of the matrix
+    int has_neighbor[4];
+    int nb_rows, nb_cols;       // dimensions of the local matrix
+    int offsets[5];             // the message of the neighbor n is [offsets[n]..offsets[n+1]-1] in send and recv
+    real *send, *recv;          // packed buffers, mapped on the accelerator
+    int device_mpi;             // 1 : MPI reads and writes the buffers of the accelerator, 0 : staged through the host
+    MPI_Request reqs[8];        // receptions, then sendings
+} device_halo;
+
+
+/**
+ * 1 if the MPI library can send and receive from the memory of the accelerator : LAPLACE_DEVICE_MPI if it is set,
+ * otherwise the answer of a CUDA-aware Open MPI (0 for the other libraries)
+ */
+static int device_aware_mpi(void)
+{
+    const char *value = getenv("LAPLACE_DEVICE_MPI");
+    if (value != NULL) { return atoi(value) != 0; }
+#if defined(MPIX_CUDA_AWARE_SUPPORT) && MPIX_CUDA_AWARE_SUPPORT
+    return MPIX_Query_cuda_support();
+#else
+    return 0;
+#endif
+}
+
+
+/**
+ * Choose the accelerator of this processor (node rank modulo the accelerators of the node, collective on comm),
+ * and print the configuration (processor 0). Returns the number of accelerators of the node.
+ */
+static int select_device(MPI_Comm comm, int me, int verbosity)
+{
+    MPI_Comm node_comm;
+    int node_rank;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, me, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_free(&node_comm);
+
+    int nb_devices = omp_get_num_devices();
+    if (nb_devices > 0) { omp_set_default_device(node_rank % nb_devices); }
+    if (me == 0 && verbosity >= 1)
+    {
+        if (nb_devices > 0) { printf("Backend gpu: %d accelerators per node, GPU-aware MPI: %s\n", nb_devices, device_aware_mpi() ? "yes" : "no (staged through the host)"); }
+        else                { printf("Backend gpu: no accelerator, the kernels run on the host\n"); }
+    }
+    return nb_devices;
+}
+
+
+/**
+ * Create the exchange of the adjacent values of the local matrix of grid, and map its buffers on the accelerator
+ */
+static void init_device_halo(device_halo *h, const processor_grid *grid, int device_mpi)
+{
+    h->comm = grid->comm;
+    MPI_Cart_shift(grid->comm, 0, 1, &h->neighbors[0], &h->neighbors[1]);
+    MPI_Cart_shift(grid->comm, 1, 1, &h->neighbors[2], &h->neighbors[3]);
+    h->nb_rows = grid->Nlocal_rows;
+    h->nb_cols = grid->Nlocal_cols;
+    int counts[4] = {h->nb_cols-2, h->nb_cols-2, h->nb_rows-2, h->nb_rows-2}; // a SIGNIFICANT row or column per neighbor
+    h->offsets[0] = 0;
+    for (int n = 0; n < 4; n++)
+    {
+        h->has_neighbor[n] = grid->has_neighbor[n];
+        h->offsets[n+1] = h->offsets[n] + counts[n];
+    }
+    h->device_mpi = device_mpi;
+    int total = h->offsets[4];
+    real *send = (real*)malloc(total*sizeof(real));
+    real *recv = (real*)malloc(total*sizeof(real));
+    if (send == NULL || recv == NULL) { exit(-1); } // Check if the memory has been well allocated
+    #pragma omp target enter data map(alloc: send[0:total], recv[0:total])
+    h->send = send;
+    h->recv = recv;
+    for (int n = 0; n < 8; n++)
+    {
+        h->reqs[n] = MPI_REQUEST_NULL;
+    }
+}
+
+
+static void free_device_halo(device_halo *h)
+{
+    real *send = h->send, *recv = h->recv;
+    int total = h->offsets[4];
+    #pragma omp target exit data map(delete: send[0:total], recv[0:total])
+    free(send);
+    free(recv);
+}
+
+
+/**
+ * Pack the SIGNIFICANT rows and columns of tab (on the accelerator) next to each neighbor in h->send
+ */
+static void pack_halo(device_halo *h, const real *tab, long nb_values)
+{
+    real *send = h->send;
+    int nb_cols = h->nb_cols, block_rows = h->nb_rows-2, block_cols = h->nb_cols-2;
+    int above = h->offsets[0], under = h->offsets[1], left = h->offsets[2], right = h->offsets[3], total = h->offsets[4];
+    int longest = block_rows > block_cols ? block_rows : block_cols;
+    #pragma omp target teams distribute parallel for map(alloc: tab[0:nb_values], send[0:total])
+    for (int k = 0; k < longest; k++)
+    {
+        if (k < block_cols)
+        {
+            send[above+k] = tab[nb_cols + 1+k];                     // first significant row
+            send[under+k] = tab[(long)block_rows*nb_cols + 1+k];    // last significant row
+        }
+        if (k < block_rows)
+        {
+            send[left+k]  = tab[(long)(k+1)*nb_cols + 1];           // first significant column
+            send[right+k] = tab[(long)(k+1)*nb_cols + block_cols];  // last significant column
+        }
+    }
+}
+
+
+/**
+ * Unpack the messages of h->recv in the ADJACENT rows and columns of tab (on the accelerator), on the sides with a neighbor
+ */
+static void unpack_halo(device_halo *h, real *tab, long nb_values)
+{
+    real *recv = h->recv;
+    int nb_cols = h->nb_cols, block_rows = h->nb_rows-2, block_cols = h->nb_cols-2;
+    int above = h->offsets[0], under = h->offsets[1], left = h->offsets[2], right = h->offsets[3], total = h->offsets[4];
+    int has_above = h->has_neighbor[0], has_under = h->has_neighbor[1], has_left = h->has_neighbor[2], has_right = h->has_neighbor[3];
+    int longest = block_rows > block_cols ? block_rows : block_cols;
+    #pragma omp target teams distribute parallel for map(alloc: tab[0:nb_values], recv[0:total])
+    for (int k = 0; k < longest; k++)
+    {
+        if (k < block_cols)
+        {
+            if (has_above) { tab[1+k] = recv[above+k]; }
+            if (has_under) { tab[(long)(block_rows+1)*nb_cols + 1+k] = recv[under+k]; }
+        }
+        if (k < block_rows)
+        {
+            if (has_left)  { tab[(long)(k+1)*nb_cols] = recv[left+k]; }
+            if (has_right) { tab[(long)(k+1)*nb_cols + block_cols+1] = recv[right+k]; }
+        }
+    }
+}
+
+
+/**
+ * Post the messages of the packed buffers send and recv (addresses of the accelerator or of the host) :
+ * the message to the neighbor n has the tag n, the one from the neighbor n has the tag of the opposite direction
+ */
+static void post_messages(device_halo *h, real *send, real *recv)
+{
+    for (int n = 0; n < 4; n++)
+    {
+        int count = h->offsets[n+1] - h->offsets[n];
+        MPI_Irecv(recv + h->offsets[n], count, LAPLACE_MPI_REAL, h->neighbors[n], n^1, h->comm, &h->reqs[n]);
+        MPI_Isend(send + h->offsets[n], count, LAPLACE_MPI_REAL, h->neighbors[n], n, h->comm, &h->reqs[4+n]);
+    }
+}
+
+
+/**
+ * Copy count values of buffer from the accelerator to the host, or from the host to the accelerator
+ */
+static void update_host(real *buffer, int count)
+{
+    (void)buffer; // only named by the directive, which the compiler does not count as a use
+    #pragma omp target update from(buffer[0:count])
+}
+
+
+static void update_device(real *buffer, int count)
+{
+    (void)buffer;
+    #pragma omp target update to(buffer[0:count])
+}
+
+
+/**
+ * Start the exchange of the adjacent values of tab, as start_update_matrix
+ */
+static void start_device_exchange(device_halo *h, const real *tab, long nb_values)
+{
+    timer_phase previous = timer_switch(TIMER_HALO_START);
+    pack_halo(h, tab, nb_values);
+    real *send = h->send, *recv = h->recv;
+    if (h->device_mpi)
+    {
+        #pragma omp target data use_device_ptr(send, recv)
+        {
+            post_messages(h, send, recv);
+        }
+    }
+    else
+    {
+        update_host(send, h->offsets[4]);
+        post_messages(h, send, recv);
+    }
+    timer_switch(previous);
+}
+
+
+/**
+ * Complete the exchange started by start_device_exchange, as wait_update_matrix
+ */
+static void wait_device_exchange(device_halo *h, real *tab, long nb_values)
+{
+    timer_phase previous = timer_switch(TIMER_HALO_WAIT);
+    MPI_Waitall(8, h->reqs, MPI_STATUSES_IGNORE);
+    if (!h->device_mpi)
+    {
+        update_device(h->recv, h->offsets[4]);
+    }
+    unpack_halo(h, tab, nb_values);
+    timer_switch(previous);
+}
+
+
+/**
+ * Jacobi iteration on a region of the local matrix (on the accelerator), as stencil_sweep
+ */
+static double device_sweep(const real *current, real *next, const stencil_region *region, int nb_cols, long nb_values, int with_error)
+{
+    int first_row = region->first_row, last_row = region->last_row, first_col = region->first_col, last_col = region->last_col;
+    if (first_row > last_row || first_col > last_col) { return 0; }
+
+    double local_error_sum = 0;
+    #pragma omp target teams distribute parallel for collapse(2) reduction(+:local_error_sum) map(alloc: current[0:nb_values], next[0:nb_values]) map(tofrom: local_error_sum)
+    for (int i = first_row; i <= last_row; i++)
+    {
+        for (int j = first_col; j <= last_col; j++)
+        {
+            real_calc top_neighbor     = current[j+(long)(i-1)*nb_cols];
+            real_calc bottom_neighbor  = current[j+(long)(i+1)*nb_cols];
+            real_calc left_neighbor    = current[(j-1)+(long)i*nb_cols];
+            real_calc right_neighbor   = current[(j+1)+(long)i*nb_cols];
+
+            real_calc new_value = (real_calc)0.25*(bottom_neighbor + top_neighbor + left_neighbor + right_neighbor); // same formula as stencil.c
+            real_calc diff = new_value - current[j+(long)i*nb_cols];
+
+            next[j+(long)i*nb_cols] = new_value;
+            if (with_error) { local_error_sum += diff*diff; }
+        }
+    }
+    return local_error_sum;
+}
+
+
+/**
+ * Red-black half-sweep on a region of the local matrix (on the accelerator), as stencil_relax_color without right-hand side :
+ * the cells (i,j) such that (i+j+parity)%2 == 0, a thread per cell of the colour
+ */
+static double device_relax_color(real *tab, const stencil_region *region, int nb_cols, long nb_values, int parity, real omega, int with_error)
+{
+    int first_row = region->first_row, last_row = region->last_row, first_col = region->first_col, last_col = region->last_col;
+    if (first_row > last_row || first_col > last_col) { return 0; }
+
+    int half_cols = (last_col-first_col+2)/2; // cells of a colour on a row, at most
+    double local_error_sum = 0;
+    #pragma omp target teams distribute parallel for collapse(2) reduction(+:local_error_sum) map(alloc: tab[0:nb_values]) map(tofrom: local_error_sum)
+    for (int i = first_row; i <= last_row; i++)
+    {
+        for (int k = 0; k < half_cols; k++)
+        {
+            int j = first_col + ((i+first_col+parity) & 1) + 2*k; // first column of the colour on this row, as stencil.c
+            if (j > last_col) { continue; }
+            real_calc value = tab[j+(long)i*nb_cols];
+            real_calc gauss_seidel = (real_calc)0.25*(tab[j+(long)(i+1)*nb_cols] + tab[j+(long)(i-1)*nb_cols] + tab[(j-1)+(long)i*nb_cols] + tab[(j+1)+(long)i*nb_cols]);
+            real_calc new_value = (omega == 1) ? gauss_seidel : value + omega*(gauss_seidel - value);
+            real_calc diff = new_value - value;
+
+            tab[j+(long)i*nb_cols] = new_value;
+            if (with_error) { local_error_sum += diff*diff; }
+        }
+    }
+    return local_error_sum;
+}
+
+
+int offload_available(void)
+{
+    return 1;
+}
+
+
+int laplace_offload(real *local_tab, processor_grid *grid, solver_options *options, int first_iter)
+{
+    int me = grid->me;
+    int Nlocal_rows = grid->Nlocal_rows, Nlocal_cols = grid->Nlocal_cols;
+    long nb_values = (long)Nlocal_rows*Nlocal_cols;
+    halo_exchange *halo = &grid->halo;
+
+    int nb_devices = select_device(grid->comm, me, options->verbosity);
+    device_halo exchange;
+    init_device_halo(&exchange, grid, nb_devices == 0 || device_aware_mpi()); // without accelerator, the buffers are the host ones
+
+    real *current = local_tab; // values of the previous iteration
+    real *new_tab = NULL;      // temporary tab to store new values of local_tab (Jacobi only, the red-black methods are in place)
+    if (options->method == METHOD_JACOBI)
+    {
+        new_tab = alloc_matrix(Nlocal_rows, Nlocal_cols);
+        if (new_tab == NULL) { exit(-1); } // Check if the memory has been well allocated
+    }
+    real *next = new_tab;      // values computed by this iteration
+    timer_switch(TIMER_COPY);
+    #pragma omp target enter data map(to: local_tab[0:nb_values])
+    if (new_tab != NULL)
+    {
+        copy_matrix(new_tab, local_tab, Nlocal_rows, Nlocal_cols); // same adjacent values as local_tab
+        #pragma omp target enter data map(to: new_tab[0:nb_values])
+    }
+    timer_switch(TIMER_OTHER);
+
+    stencil_region parts[5]; // inner block and outer ring of my block, computed before and after the arrival of the adjacent data
+    split_block(1, Nlocal_rows-2, 1, Nlocal_cols-2, grid->has_neighbor, parts);
+
+    int iter_count = first_iter;
+    convergence_monitor monitor; // reduction of the error, checkpoints and snapshots (from the host values)
+    init_convergence(&monitor, options, halo->comm, &grid->layout);
+
+    timer_switch(TIMER_COMPUTE); // the setup above is charged to TIMER_OTHER
+    while(!is_converged(&monitor) && (options->max_iter == 0 || iter_count < options->max_iter))
+    {
+        double local_error_sum = 0;
+        iter_count++;
+        int with_error = (iter_count % options->check_every == 0); // the error is only needed for the convergence check
+
+        if (options->method == METHOD_JACOBI)
+        {
+            start_device_exchange(&exchange, current, nb_values); // messages in flight during the inner block
+            local_error_sum += device_sweep(current, next, &parts[0], Nlocal_cols, nb_values, with_error);
+            wait_device_exchange(&exchange, current, nb_values);
+
+            for (int p = 1; p < 5; p++) // outer ring of the significant values
+            {
+                local_error_sum += device_sweep(current, next, &parts[p], Nlocal_cols, nb_values, with_error);
+            }
+
+            // The new values become the current ones (no copy)
+            real *swap = current;
+            current = next;
+            next = swap;
+        }
+        else
+        {
+            real omega = options->omega;
+            for (int color = 0; color < 2; color++) // red cells, then black cells
+            {
+                int parity = (color + grid->layout.starts[0] + grid->layout.starts[1]) & 1; // as laplace()
+                start_device_exchange(&exchange, current, nb_values); // adjacent data of the other colour
+                local_error_sum += device_relax_color(current, &parts[0], Nlocal_cols, nb_values, parity, omega, with_error);
+                wait_device_exchange(&exchange, current, nb_values);
+
+                for (int p = 1; p < 5; p++) // outer ring
+                {
+                    local_error_sum += device_relax_color(current, &parts[p], Nlocal_cols, nb_values, parity, omega, with_error);
+                }
+            }
+        }
+
+        if (wait_convergence_check(&monitor)) { break; } // the error of a previous iteration has been reduced during this one
+        if (with_error)
+        {
+            check_convergence(&monitor, iter_count, local_error_sum, NULL);
+        }
+
+        if (convergence_outputs_due(&monitor, iter_count))
+        {
+            timer_switch(TIMER_COPY);
+            #pragma omp target update from(current[0:nb_values]) // the checkpoints and snapshots are written from the host
+            timer_switch(TIMER_COMPUTE);
+            save_convergence_outputs(&monitor, current, iter_count);
+        }
+    }
+    timer_switch(TIMER_OTHER);
+
+    // The final values go back to the host
+    timer_switch(TIMER_COPY);
+    #pragma omp target update from(current[0:nb_values])
+    #pragma omp target exit data map(delete: local_tab[0:nb_values])
+    if (new_tab != NULL)
+    {
+        #pragma omp target exit data map(delete: new_tab[0:nb_values])
+    }
+    timer_switch(TIMER_OTHER);
+    free_device_halo(&exchange);
+
+    finish_convergence(&monitor, current, iter_count);
+    update_matrix (halo, current); // the adjacent data match the final values
+    timer_switch(TIMER_COPY);
+    if (current != local_tab)
+    {
+        copy_matrix(local_tab, current, Nlocal_rows, Nlocal_cols); // a single copy when the final values are in new_tab
+    }
+    timer_switch(TIMER_OTHER);
+    free(new_tab);
+    return iter_count - first_iter;
+}
+
+#else
+
+int offload_available(void)
+{
+    return 0;
+}
+
+
+int laplace_offload(real *local_tab, processor_grid *grid, solver_options *options, int first_iter)
+{
+    (void)local_tab; (void)options; (void)first_iter;
+    if (grid->me == 0) { printf("ERROR: --backend gpu needs a build with -fopenmp -DLAPLACE_OFFLOAD\n"); }
+    MPI_Abort(grid->comm, -1);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,44 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Accelerator backend of the 1D and 2D solvers (--backend gpu) : OpenMP target offload
+
+Compiled with -fopenmp -DLAPLACE_OFFLOAD and a compiler configured for the accelerators
+(for example gcc -foffload=nvptx-none or -foffload=amdgcn-amdhsa, clang -fopenmp-targets=nvptx64).
+Without -DLAPLACE_OFFLOAD, the backend is not available and the programs refuse --backend gpu.
+With -DLAPLACE_OFFLOAD but no accelerator on the node, the OpenMP runtime runs the kernels on the host.
+
+Each processor uses one accelerator of its node (node rank modulo the accelerators). The matrices stay in the memory
+of the accelerator for the whole loop : the sweeps, the error sums and the packing of the adjacent values are device kernels,
+and only the messages and the checkpoints leave it. With a GPU-aware MPI library (CUDA-aware Open MPI is detected,
+LAPLACE_DEVICE_MPI=1 or 0 forces the choice), the messages are sent and received from the device buffers ;
+otherwise the packed buffers are staged through the host.
+
+----------------------------------------------------------------------
+*/
+
+#ifndef OFFLOAD_H
+#define OFFLOAD_H
+
+#include "precision.h"
+#include "options.h"
+#include "grid.h"
+
+
+/**
+ * Returns 1 if the programs were compiled with the accelerator backend
+ */
+int offload_available(void);
+
+
+/**
+ * laplace() on the accelerator, for --method jacobi, gauss-seidel and sor with a halo depth of 1 : same iterations,
+ * same new values (the error sums are added in another order), same convergence checks (options->check_every,
+ * options->async_check), printing and checkpoints. At the end, local_tab contains the final values
+ * (and up-to-date adjacent data). Returns the number of iterations computed.
+ */
+int laplace_offload(real *local_tab, processor_grid *grid, solver_options *options, int first_iter);
+
+
+#endif
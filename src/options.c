@@ -0,0 +1,626 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Command line options, shared by all the decompositions
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include "options.h"
+#include "output.h"
+#include "timers.h"
+
+
+/**
+ * Print the usage of the program (only by the processor 0)
+ */
+static void print_usage(int me, char *program)
+{
+    if (me != 0) { return; }
+    printf("Usage: mpirun -np [number of processors] %s [options] [N square matrix dimension]\n", program);
+    printf("Options:\n");
+    printf("  --method M        jacobi (default), gauss-seidel (red-black), sor (red-black successive over-relaxation)\n");
+    printf("                    multigrid (V-cycles) or cg (conjugate gradient), not in laplace_3D\n");
+    printf("  --omega W         relaxation factor of sor, 0 < W < 2 (default 2/(1+sin(pi/(N+1))), optimal for this problem)\n");
+    printf("  --preconditioner P\n");
+    printf("                    preconditioner of cg : none (default), jacobi or multigrid (one V-cycle)\n");
+    printf("  --decomposition D slab (whole rows, default of laplace_1D) or block (square blocks, default of laplace_2D), not in laplace_3D\n");
+    printf("  --tolerance EPS   required accuracy : the loop stops when the error is lower (default 1e-2)\n");
+    printf("  --max-iter M      maximum number of iterations, 0 for no limit (default 1000000)\n");
+    printf("  --check-every K   compute and reduce the error every K iterations only (default 1)\n");
+    printf("  --async-check     overlap the reduction of the error with the next iteration (MPI_Iallreduce)\n");
+    printf("  --norm E          error compared with the tolerance : l2 (default, of the changes), max (largest change)\n");
+    printf("                    or relative (l2 of the changes / l2 of the values), not in laplace_3D\n");
+    printf("  --deterministic   exact sums of the errors : the same convergence with any number of processors and threads, not in laplace_3D\n");
+    printf("  --halo-depth K    jacobi : exchange K adjacent layers at once, then compute K iterations (default 1)\n");
+    printf("  --tile-cols W     jacobi : compute the sweeps in strips of W columns (cache blocking), or \"auto\" (timed at start)\n");
+    printf("  --wavefront       jacobi : compute the K iterations of --halo-depth K row by row (temporal cache blocking)\n");
+    printf("  --boundary V      value outside all the edges of the matrix (default -1)\n");
+    printf("  --bottom V, --top V, --left V, --right V\n");
+    printf("                    value outside one edge, as the matrix is printed (the row 0 is at the bottom)\n");
+    printf("  --front V, --back V\n");
+    printf("                    laplace_3D : value outside the first and the last plane\n");
+    printf("  --initial G       initial guess : \"rank\" (rank of the processor, default), a value, \"boundary\" (interpolation of\n");
+    printf("                    the boundary values) or \"coarse\" (solution on a coarse matrix, interpolated), not in laplace_3D\n");
+    printf("  --initial-file FILE\n");
+    printf("                    initial guess : the binary result FILE of a previous run, of any size (interpolated), not in laplace_3D\n");
+    printf("  --verbosity L     0 : benchmark, only the times are printed (no gather, no file)\n");
+    printf("                    1 : production, errors and summary printed, result file saved\n");
+    printf("                    2 : debug, final and local matrices printed too (default)\n");
+    printf("  --log-every K     print the error every K iterations (default 1)\n");
+    printf("  --output-format F text (gathered, default), binary (parallel MPI-IO with a header), raw (parallel, values only)\n");
+    printf("                    or compressed (each block compressed by its processor, then written in parallel), see output.h\n");
+    printf("  --output FILE     name of the result file\n");
+    printf("  --output-region R0:R1,C0:C1\n");
+    printf("                    binary, raw and compressed : only write the rows R0 to R1-1 and the columns C0 to C1-1\n");
+    printf("  --output-stride S binary, raw and compressed : only write every S rows and columns (downsampling, default 1)\n");
+    printf("  --compress-tolerance EPS\n");
+    printf("                    compressed : the values of the file are within EPS of the computed ones (default 0 : lossless),\n");
+    printf("                    at least the largest boundary or initial value / 2^53\n");
+    printf("  --snapshot-every K\n");
+    printf("                    binary, raw and compressed : also write the result file every K iterations (name_K.bin), in the background\n");
+    printf("  --checkpoint FILE write checkpoints in FILE (in the background), and when the maximum number of iterations is reached\n");
+    printf("  --checkpoint-every K\n");
+    printf("                    write a checkpoint every K iterations\n");
+    printf("  --checkpoint-interval T\n");
+    printf("                    write a checkpoint every T seconds (tested at the convergence checks)\n");
+    printf("  --restart         continue the computation from the checkpoint FILE, possibly with another number of processors\n");
+    printf("  --warmup W        benchmark : compute W times from the initial values before the measured trials (default 0)\n");
+    printf("  --repeat R        benchmark : measure R computations from the initial values (default 1), see --report\n");
+    printf("  --report FILE     benchmark : append the times, GLUP/s, bandwidth and phases of the trials to FILE\n");
+    printf("  --report-format F csv (a header line in a new file, then a line per run, default) or json (an object per line)\n");
+    printf("  --profile         print the time per iteration of each phase (compute, copy, halo, reduction) : min, avg, max over the processors\n");
+    printf("  --huge-pages      align the matrices of at least 2 MB on huge pages and ask for transparent huge pages\n");
+    printf("  --affinity        print the cores and NUMA nodes of the processors and threads, and check their binding\n");
+    printf("  --backend B       cpu (default) or gpu : jacobi, gauss-seidel and sor on an accelerator (build with -DLAPLACE_OFFLOAD), not in laplace_3D\n");
+    printf("  --balance-every K jacobi, gauss-seidel and sor : every K iterations, move the limits of the blocks to balance the compute time\n");
+    printf("                    of the processors (heterogeneous nodes), not in laplace_3D\n");
+    printf("  --batch FILE      jacobi, gauss-seidel and sor : solve together the problems of FILE, a line of boundary values per problem\n");
+    printf("                    (bottom top left right), a result file per problem (name_b.txt), not in laplace_3D\n");
+    printf("example: mpirun -np 4 %s --tolerance 1e-4 --top 1 --initial 0 12\n", program);
+}
+
+
+/**
+ * Read a strictly positive integer, returns -1 if the text is not one
+ */
+static int read_positive_int(const char *text)
+{
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value <= 0 || value > 2147483647) { return -1; }
+    return (int)value;
+}
+
+
+/**
+ * Read a real number, returns -1 if the text is not one (and 0 otherwise)
+ */
+static int read_double(const char *text, double *value)
+{
+    char *end;
+    *value = strtod(text, &end);
+    if (end == text || *end != '\0' || !isfinite(*value)) { return -1; }
+    return 0;
+}
+
+
+int parse_options(int argc, char *argv[], int me, solver_options *options)
+{
+    options->N = 0;
+    options->method = METHOD_JACOBI;
+    options->decomposition = DECOMPOSITION_DEFAULT; // chosen by the program
+    options->omega = 0; // computed from N
+    options->preconditioner = PRECONDITIONER_NONE;
+    options->tolerance = 1.0e-2;
+    options->max_iter = 1000000;
+    options->check_every = 1;
+    options->async_check = 0;
+    options->halo_depth = 1;
+    options->tile_cols = 0;
+    options->wavefront = 0;
+    options->norm = NORM_L2;
+    options->deterministic = 0;
+    for (int edge = 0; edge < NB_EDGES; edge++)
+    {
+        options->boundary[edge] = -1;
+    }
+    options->initial = INITIAL_RANK;
+    options->initial_value = 0;
+    options->initial_file = NULL;
+    options->verbosity = 2;
+    options->log_every = 1;
+    options->format = OUTPUT_TEXT;
+    options->output = NULL;
+    options->region[0] = -1; // the whole matrix, once N is known
+    options->output_stride = 1;
+    options->compress_tolerance = 0;
+    options->snapshot_every = 0;
+    options->checkpoint = NULL;
+    options->checkpoint_every = 0;
+    options->checkpoint_interval = 0;
+    options->restart = 0;
+    options->warmup = 0;
+    options->repeat = 1;
+    options->report = NULL;
+    options->report_format = REPORT_CSV;
+    options->profile = 0;
+    options->huge_pages = 0;
+    options->affinity = 0;
+    options->backend = BACKEND_CPU;
+    options->balance_every = 0;
+    options->batch = NULL;
+
+    static struct option long_options[] =
+    {
+        {"method",      required_argument, NULL, 'M'},
+        {"decomposition", required_argument, NULL, 'D'},
+        {"omega",       required_argument, NULL, 'w'},
+        {"preconditioner", required_argument, NULL, 'P'},
+        {"tolerance",   required_argument, NULL, 't'},
+        {"max-iter",    required_argument, NULL, 'm'},
+        {"check-every", required_argument, NULL, 'k'},
+        {"async-check", no_argument,       NULL, 'a'},
+        {"norm",        required_argument, NULL, 'O'},
+        {"deterministic", no_argument,     NULL, 'd'},
+        {"halo-depth",  required_argument, NULL, 'H'},
+        {"tile-cols",   required_argument, NULL, 'C'},
+        {"wavefront",   no_argument,       NULL, 'W'},
+        {"boundary",    required_argument, NULL, 'B'},
+        {"bottom",      required_argument, NULL, 'b'},
+        {"top",         required_argument, NULL, 'T'},
+        {"left",        required_argument, NULL, 'l'},
+        {"right",       required_argument, NULL, 'r'},
+        {"front",       required_argument, NULL, 'F'},
+        {"back",        required_argument, NULL, 'G'},
+        {"initial",     required_argument, NULL, 'i'},
+        {"initial-file", required_argument, NULL, 'N'},
+        {"verbosity",   required_argument, NULL, 'v'},
+        {"log-every",   required_argument, NULL, 'L'},
+        {"output-format", required_argument, NULL, 'f'},
+        {"output",      required_argument, NULL, 'o'},
+        {"output-region", required_argument, NULL, 'Z'},
+        {"output-stride", required_argument, NULL, 'S'},
+        {"compress-tolerance", required_argument, NULL, 'z'},
+        {"snapshot-every", required_argument, NULL, 'Q'},
+        {"checkpoint",  required_argument, NULL, 'c'},
+        {"checkpoint-every", required_argument, NULL, 'K'},
+        {"checkpoint-interval", required_argument, NULL, 'I'},
+        {"restart",     no_argument,       NULL, 'R'},
+        {"warmup",      required_argument, NULL, 'u'},
+        {"repeat",      required_argument, NULL, 'n'},
+        {"report",      required_argument, NULL, 'j'},
+        {"report-format", required_argument, NULL, 'J'},
+        {"profile",     no_argument,       NULL, 'p'},
+        {"huge-pages",  no_argument,       NULL, 'g'},
+        {"affinity",    no_argument,       NULL, 'A'},
+        {"backend",     required_argument, NULL, 'E'},
+        {"balance-every", required_argument, NULL, 'Y'},
+        {"batch",       required_argument, NULL, 'X'},
+        {"help",        no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    double value;
+
+    opterr = 0; // the errors are printed here, by the processor 0 only
+    optind = 1;
+    int option;
+    while ((option = getopt_long(argc, argv, "h", long_options, NULL)) != -1)
+    {
+        switch (option)
+        {
+            case 'M':
+                if      (strcmp(optarg, "jacobi") == 0)       { options->method = METHOD_JACOBI; }
+                else if (strcmp(optarg, "gauss-seidel") == 0) { options->method = METHOD_GAUSS_SEIDEL; }
+                else if (strcmp(optarg, "sor") == 0)          { options->method = METHOD_SOR; }
+                else if (strcmp(optarg, "multigrid") == 0)    { options->method = METHOD_MULTIGRID; }
+                else if (strcmp(optarg, "cg") == 0)           { options->method = METHOD_CG; }
+                else
+                {
+                    if (me == 0) { printf("ERROR: --method expects jacobi, gauss-seidel, sor, multigrid or cg, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'D':
+                if      (strcmp(optarg, "slab") == 0)  { options->decomposition = DECOMPOSITION_SLAB; }
+                else if (strcmp(optarg, "block") == 0) { options->decomposition = DECOMPOSITION_BLOCK; }
+                else
+                {
+                    if (me == 0) { printf("ERROR: --decomposition expects slab or block, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'w':
+                if (read_double(optarg, &value) != 0 || value <= 0 || value >= 2)
+                {
+                    if (me == 0) { printf("ERROR: --omega expects a number between 0 and 2 (excluded), but we have %s\n", optarg); }
+                    return -1;
+                }
+                options->omega = value;
+                break;
+            case 'P':
+                if      (strcmp(optarg, "none") == 0)      { options->preconditioner = PRECONDITIONER_NONE; }
+                else if (strcmp(optarg, "jacobi") == 0)    { options->preconditioner = PRECONDITIONER_JACOBI; }
+                else if (strcmp(optarg, "multigrid") == 0) { options->preconditioner = PRECONDITIONER_MULTIGRID; }
+                else
+                {
+                    if (me == 0) { printf("ERROR: --preconditioner expects none, jacobi or multigrid, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'k':
+                options->check_every = read_positive_int(optarg);
+                if (options->check_every < 0)
+                {
+                    if (me == 0) { printf("ERROR: --check-every expects a strictly positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'a':
+                options->async_check = 1;
+                break;
+            case 'O':
+                if      (strcmp(optarg, "l2") == 0)       { options->norm = NORM_L2; }
+                else if (strcmp(optarg, "max") == 0)      { options->norm = NORM_MAX; }
+                else if (strcmp(optarg, "relative") == 0) { options->norm = NORM_RELATIVE; }
+                else
+                {
+                    if (me == 0) { printf("ERROR: --norm expects l2, max or relative, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'd':
+                options->deterministic = 1;
+                break;
+            case 'H':
+                options->halo_depth = read_positive_int(optarg);
+                if (options->halo_depth < 0)
+                {
+                    if (me == 0) { printf("ERROR: --halo-depth expects a strictly positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'C':
+                options->tile_cols = (strcmp(optarg, "auto") == 0) ? TILE_COLS_AUTO : read_positive_int(optarg);
+                if (options->tile_cols == -1 && strcmp(optarg, "auto") != 0)
+                {
+                    if (me == 0) { printf("ERROR: --tile-cols expects a strictly positive integer or auto, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'W':
+                options->wavefront = 1;
+                break;
+            case 't':
+                if (read_double(optarg, &options->tolerance) != 0 || options->tolerance <= 0)
+                {
+                    if (me == 0) { printf("ERROR: --tolerance expects a strictly positive number, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'm':
+                options->max_iter = (strcmp(optarg, "0") == 0) ? 0 : read_positive_int(optarg);
+                if (options->max_iter < 0)
+                {
+                    if (me == 0) { printf("ERROR: --max-iter expects a positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'B': case 'b': case 'T': case 'l': case 'r': case 'F': case 'G':
+                if (read_double(optarg, &value) != 0)
+                {
+                    if (me == 0) { printf("ERROR: a boundary value must be a number, but we have %s\n", optarg); }
+                    return -1;
+                }
+                if (option == 'B' || option == 'b') { options->boundary[EDGE_BOTTOM] = value; }
+                if (option == 'B' || option == 'T') { options->boundary[EDGE_TOP]    = value; }
+                if (option == 'B' || option == 'l') { options->boundary[EDGE_LEFT]   = value; }
+                if (option == 'B' || option == 'r') { options->boundary[EDGE_RIGHT]  = value; }
+                if (option == 'B' || option == 'F') { options->boundary[EDGE_FRONT]  = value; }
+                if (option == 'B' || option == 'G') { options->boundary[EDGE_BACK]   = value; }
+                break;
+            case 'i':
+                if (strcmp(optarg, "rank") == 0)
+                {
+                    options->initial = INITIAL_RANK;
+                }
+                else if (strcmp(optarg, "boundary") == 0)
+                {
+                    options->initial = INITIAL_BOUNDARY;
+                }
+                else if (strcmp(optarg, "coarse") == 0)
+                {
+                    options->initial = INITIAL_COARSE;
+                }
+                else if (read_double(optarg, &value) == 0)
+                {
+                    options->initial = INITIAL_CONSTANT;
+                    options->initial_value = value;
+                }
+                else
+                {
+                    if (me == 0) { printf("ERROR: --initial expects \"rank\", a number, \"boundary\" or \"coarse\", but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'N':
+                options->initial = INITIAL_FILE;
+                options->initial_file = optarg;
+                break;
+            case 'v':
+                options->verbosity = (strcmp(optarg, "0") == 0) ? 0 : read_positive_int(optarg);
+                if (options->verbosity < 0 || options->verbosity > 2)
+                {
+                    if (me == 0) { printf("ERROR: --verbosity expects 0, 1 or 2, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'L':
+                options->log_every = read_positive_int(optarg);
+                if (options->log_every < 0)
+                {
+                    if (me == 0) { printf("ERROR: --log-every expects a strictly positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'f':
+                if      (strcmp(optarg, "text") == 0)   { options->format = OUTPUT_TEXT; }
+                else if (strcmp(optarg, "binary") == 0) { options->format = OUTPUT_BINARY; }
+                else if (strcmp(optarg, "raw") == 0)    { options->format = OUTPUT_RAW; }
+                else if (strcmp(optarg, "compressed") == 0) { options->format = OUTPUT_COMPRESSED; }
+                else
+                {
+                    if (me == 0) { printf("ERROR: --output-format expects text, binary, raw or compressed, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'o':
+                options->output = optarg;
+                break;
+            case 'Z':
+            {
+                char end;
+                int *region = options->region;
+                if (sscanf(optarg, "%d:%d,%d:%d%c", &region[0], &region[1], &region[2], &region[3], &end) != 4
+                    || region[0] < 0 || region[1] <= region[0] || region[2] < 0 || region[3] <= region[2])
+                {
+                    if (me == 0) { printf("ERROR: --output-region expects R0:R1,C0:C1 with 0 <= R0 < R1 and 0 <= C0 < C1, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            }
+            case 'S':
+                options->output_stride = read_positive_int(optarg);
+                if (options->output_stride < 0)
+                {
+                    if (me == 0) { printf("ERROR: --output-stride expects a strictly positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'z':
+                if (read_double(optarg, &options->compress_tolerance) != 0 || options->compress_tolerance < 0)
+                {
+                    if (me == 0) { printf("ERROR: --compress-tolerance expects a positive number, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'Q':
+                options->snapshot_every = read_positive_int(optarg);
+                if (options->snapshot_every < 0)
+                {
+                    if (me == 0) { printf("ERROR: --snapshot-every expects a strictly positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'c':
+                options->checkpoint = optarg;
+                break;
+            case 'K':
+                options->checkpoint_every = read_positive_int(optarg);
+                if (options->checkpoint_every < 0)
+                {
+                    if (me == 0) { printf("ERROR: --checkpoint-every expects a strictly positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'I':
+                if (read_double(optarg, &options->checkpoint_interval) != 0 || options->checkpoint_interval <= 0)
+                {
+                    if (me == 0) { printf("ERROR: --checkpoint-interval expects a strictly positive number of seconds, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'R':
+                options->restart = 1;
+                break;
+            case 'u':
+                options->warmup = (strcmp(optarg, "0") == 0) ? 0 : read_positive_int(optarg);
+                if (options->warmup < 0)
+                {
+                    if (me == 0) { printf("ERROR: --warmup expects a positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'n':
+                options->repeat = read_positive_int(optarg);
+                if (options->repeat < 0)
+                {
+                    if (me == 0) { printf("ERROR: --repeat expects a strictly positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'j':
+                options->report = optarg;
+                break;
+            case 'p':
+                options->profile = 1;
+                break;
+            case 'g':
+                options->huge_pages = 1;
+                break;
+            case 'A':
+                options->affinity = 1;
+                break;
+            case 'E':
+                if      (strcmp(optarg, "cpu") == 0) { options->backend = BACKEND_CPU; }
+                else if (strcmp(optarg, "gpu") == 0) { options->backend = BACKEND_GPU; }
+                else
+                {
+                    if (me == 0) { printf("ERROR: --backend expects cpu or gpu, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'Y':
+                options->balance_every = read_positive_int(optarg);
+                if (options->balance_every < 0)
+                {
+                    if (me == 0) { printf("ERROR: --balance-every expects a strictly positive integer, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'X':
+                options->batch = optarg;
+                break;
+            case 'J':
+                if      (strcmp(optarg, "csv") == 0)  { options->report_format = REPORT_CSV; }
+                else if (strcmp(optarg, "json") == 0) { options->report_format = REPORT_JSON; }
+                else
+                {
+                    if (me == 0) { printf("ERROR: --report-format expects csv or json, but we have %s\n", optarg); }
+                    return -1;
+                }
+                break;
+            case 'h':
+                print_usage(me, argv[0]);
+                return -1;
+            default:
+                if (me == 0) { printf("ERROR: unknown or incomplete option %s\n", argv[optind-1]); }
+                print_usage(me, argv[0]);
+                return -1;
+        }
+    }
+
+    if (options->checkpoint == NULL && (options->restart || options->checkpoint_every > 0 || options->checkpoint_interval > 0))
+    {
+        if (me == 0) { printf("ERROR: --restart, --checkpoint-every and --checkpoint-interval need a --checkpoint FILE\n"); }
+        return -1;
+    }
+
+    if (optind >= argc)
+    {
+        if (me == 0) { printf("Argument missing.\n"); }
+        print_usage(me, argv[0]);
+        return -1;
+    }
+    options->N = read_positive_int(argv[optind]);
+    if (options->N < 0)
+    {
+        if (me == 0) { printf("ERROR: the matrix dimension must be a strictly positive integer, but we have %s\n", argv[optind]); }
+        return -1;
+    }
+
+    int has_region = (options->region[0] >= 0);
+    if (!has_region)
+    {
+        options->region[0] = options->region[2] = 0;
+        options->region[1] = options->region[3] = options->N;
+    }
+    if (options->region[1] > options->N || options->region[3] > options->N)
+    {
+        if (me == 0) { printf("ERROR: --output-region %d:%d,%d:%d is outside the matrix of dimension N = %d\n", options->region[0], options->region[1], options->region[2], options->region[3], options->N); }
+        return -1;
+    }
+    if (options->format == OUTPUT_TEXT && (has_region || options->output_stride > 1 || options->snapshot_every > 0))
+    {
+        if (me == 0) { printf("ERROR: --output-region, --output-stride and --snapshot-every need a parallel --output-format : binary, raw or compressed\n"); }
+        return -1;
+    }
+    if (options->compress_tolerance > 0 && options->format != OUTPUT_COMPRESSED)
+    {
+        if (me == 0) { printf("ERROR: --compress-tolerance is only used by --output-format compressed\n"); }
+        return -1;
+    }
+    double largest_value = (options->initial == INITIAL_CONSTANT) ? fabs((double)options->initial_value) : 0;
+    for (int e = 0; e < NB_EDGES; e++)
+    {
+        if (fabs((double)options->boundary[e]) > largest_value) { largest_value = fabs((double)options->boundary[e]); }
+    }
+    if (options->compress_tolerance > 0 && largest_value / (2*options->compress_tolerance) > COMPRESS_MAX_STEPS)
+    {
+        if (me == 0) { printf("ERROR: --compress-tolerance %e is too small for values up to %e : at least %e\n", options->compress_tolerance, largest_value, largest_value / (2*COMPRESS_MAX_STEPS)); }
+        return -1;
+    }
+
+    if (options->omega != 0 && options->method != METHOD_SOR)
+    {
+        if (me == 0) { printf("ERROR: --omega is only used by --method sor\n"); }
+        return -1;
+    }
+    if ((options->halo_depth > 1 || options->tile_cols != 0 || options->wavefront) && options->method != METHOD_JACOBI)
+    {
+        if (me == 0) { printf("ERROR: --halo-depth, --tile-cols and --wavefront are only used by --method jacobi\n"); }
+        return -1;
+    }
+    if (options->wavefront && options->halo_depth == 1)
+    {
+        if (me == 0) { printf("ERROR: --wavefront computes the iterations between two exchanges : it needs a --halo-depth K > 1\n"); }
+        return -1;
+    }
+    if (options->backend == BACKEND_GPU && (options->method == METHOD_MULTIGRID || options->method == METHOD_CG
+                                            || options->halo_depth > 1 || options->tile_cols != 0))
+    {
+        if (me == 0) { printf("ERROR: --backend gpu only supports --method jacobi, gauss-seidel or sor, without --halo-depth and --tile-cols\n"); }
+        return -1;
+    }
+    if (options->balance_every > 0 && (options->method == METHOD_MULTIGRID || options->method == METHOD_CG
+                                       || options->halo_depth > 1 || options->backend == BACKEND_GPU))
+    {
+        if (me == 0) { printf("ERROR: --balance-every only supports --method jacobi, gauss-seidel or sor, without --halo-depth and --backend gpu\n"); }
+        return -1;
+    }
+    if (options->balance_every > 0 && !TIMERS_ENABLED)
+    {
+        if (me == 0) { printf("ERROR: --balance-every measures the compute time of the processors : it needs a build without -DLAPLACE_NO_TIMERS\n"); }
+        return -1;
+    }
+    if (options->batch != NULL && (options->method == METHOD_MULTIGRID || options->method == METHOD_CG || options->halo_depth > 1
+                                   || options->tile_cols != 0 || options->async_check || options->checkpoint != NULL
+                                   || options->backend == BACKEND_GPU || options->balance_every > 0 || options->snapshot_every > 0 || is_benchmark(options)))
+    {
+        if (me == 0) { printf("ERROR: --batch only supports --method jacobi, gauss-seidel or sor, without --halo-depth, --tile-cols, --async-check, --checkpoint, --backend gpu, --balance-every, --snapshot-every and the benchmark options\n"); }
+        return -1;
+    }
+    if ((options->norm != NORM_L2 || options->deterministic) && (options->method == METHOD_CG || options->wavefront
+                                                                  || options->backend == BACKEND_GPU || options->batch != NULL))
+    {
+        if (me == 0) { printf("ERROR: --norm and --deterministic only support --method jacobi, gauss-seidel, sor or multigrid, without --wavefront, --backend gpu and --batch\n"); }
+        return -1;
+    }
+    if (options->preconditioner != PRECONDITIONER_NONE && options->method != METHOD_CG)
+    {
+        if (me == 0) { printf("ERROR: --preconditioner is only used by --method cg\n"); }
+        return -1;
+    }
+    if (options->method == METHOD_GAUSS_SEIDEL)
+    {
+        options->omega = 1;
+    }
+    else if (options->method == METHOD_SOR && options->omega == 0)
+    {
+        options->omega = 2.0/(1.0+sin(M_PI/(options->N+1))); // optimal factor for the 5-points laplacian on a N x N grid
+    }
+    return 0;
+}
+
+
+int is_benchmark(const solver_options *options)
+{
+    return options->warmup > 0 || options->repeat > 1 || options->report != NULL;
+}
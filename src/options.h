@@ -0,0 +1,178 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Command line options, shared by all the decompositions
+
+----------------------------------------------------------------------
+*/
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "precision.h"
+
+/**
+ * Edges of the matrix, as it is printed and saved (reverse order : the row 0 is at the bottom),
+ * and the first and last planes of a 3D matrix (laplace_3D)
+ */
+enum { EDGE_BOTTOM = 0, EDGE_TOP = 1, EDGE_LEFT = 2, EDGE_RIGHT = 3, EDGE_FRONT = 4, EDGE_BACK = 5 };
+#define NB_EDGES 6
+
+
+/**
+ * Initial values of the significant data
+ */
+typedef enum
+{
+    INITIAL_RANK,       // the rank of the processor (shows the decomposition, test mode)
+    INITIAL_CONSTANT,   // initial_value everywhere
+    INITIAL_BOUNDARY,   // interpolation of the boundary values (see guess.h)
+    INITIAL_COARSE,     // solution on a coarse matrix, interpolated (see guess.h)
+    INITIAL_FILE        // previous result of initial_file, of any size, interpolated (see guess.h)
+} initial_guess;
+
+
+/**
+ * Iterative method of the solver
+ */
+typedef enum
+{
+    METHOD_JACOBI,          // new values computed from the previous iteration only (two buffers)
+    METHOD_GAUSS_SEIDEL,    // red-black Gauss-Seidel, in place : the black cells use the new values of the red ones
+    METHOD_SOR,             // red-black successive over-relaxation, Gauss-Seidel extrapolated by the factor omega
+    METHOD_MULTIGRID,       // V-cycles with red-black Gauss-Seidel smoothing
+    METHOD_CG               // conjugate gradient, one reduction per iteration
+} solver_method;
+
+
+/**
+ * Preconditioner of METHOD_CG
+ */
+typedef enum
+{
+    PRECONDITIONER_NONE,        // plain conjugate gradient
+    PRECONDITIONER_JACOBI,      // a few Jacobi iterations on the residual equation, from 0
+    PRECONDITIONER_MULTIGRID    // one V-cycle on the residual equation, from 0
+} cg_preconditioner;
+
+
+/**
+ * Decomposition of the matrix between the processors (grid.h)
+ */
+typedef enum
+{
+    DECOMPOSITION_DEFAULT,  // the decomposition of the program (laplace_1D : slab, laplace_2D : block)
+    DECOMPOSITION_SLAB,     // whole rows : NPROC x 1 processors, 2 neighbors at most
+    DECOMPOSITION_BLOCK     // blocks : a grid of processors as square as possible, 4 neighbors at most
+} decomposition_kind;
+
+
+/**
+ * Error compared with the tolerance : norm of the change of the values between two iterations (see norms.h)
+ */
+typedef enum
+{
+    NORM_L2,        // square root of the sum of the squared changes (default)
+    NORM_MAX,       // largest absolute change of a value
+    NORM_RELATIVE   // L2 norm of the changes divided by the L2 norm of the new values
+} error_norm;
+
+
+#define TILE_COLS_AUTO -1    // tile_cols chosen by timing a few sweeps (stencil_tune_tile_cols)
+
+
+/**
+ * Where the iterations are computed
+ */
+typedef enum
+{
+    BACKEND_CPU,    // the processors and their OpenMP threads (stencil.c)
+    BACKEND_GPU     // an accelerator, the matrices stay in its memory during the iterations (offload.h)
+} execution_backend;
+
+
+/**
+ * Format of the result file
+ */
+typedef enum
+{
+    OUTPUT_TEXT,    // gathered on the processor 0 and written with fprintf (reverse order, the row 0 at the bottom)
+    OUTPUT_BINARY,  // written in parallel with MPI-IO, with a header (see io.h)
+    OUTPUT_RAW,     // written in parallel with MPI-IO, real values only
+    OUTPUT_COMPRESSED // each block compressed by its processor, then written in parallel with MPI-IO (see output.h)
+} output_format;
+
+
+/**
+ * Format of the benchmark report (bench.h)
+ */
+typedef enum
+{
+    REPORT_CSV,     // a header line (new file), then a line per run
+    REPORT_JSON     // a JSON object per run and per line (JSON Lines)
+} report_format;
+
+
+/**
+ * Options of a run, read on the command line by parse_options
+ */
+typedef struct
+{
+    int N;                  // square matrix dimension
+    solver_method method;   // iterative method
+    decomposition_kind decomposition; // decomposition of the matrix between the processors
+    real omega;            // relaxation factor of METHOD_SOR (1 for METHOD_GAUSS_SEIDEL), 2/(1+sin(pi/(N+1))) by default
+    cg_preconditioner preconditioner; // preconditioner of METHOD_CG
+    double tolerance;       // the loop stops when the error is lower (PRECISION)
+    int max_iter;           // the loop stops after max_iter iterations anyway (0 : no limit)
+    int check_every;        // the error is computed and reduced every check_every iterations only
+    int async_check;        // 1 : the reduction of the error overlaps the next iteration (MPI_Iallreduce)
+    error_norm norm;        // norm of the change compared with the tolerance
+    int deterministic;      // 1 : exact sums of the norms, the same with any number of processors and threads (see norms.h)
+    int halo_depth;         // METHOD_JACOBI : adjacent layers exchanged at once, for halo_depth iterations (1 : exchange at each iteration)
+    int tile_cols;          // METHOD_JACOBI : width of the column strips of the sweeps (0 : whole rows, TILE_COLS_AUTO : tuned)
+    int wavefront;          // METHOD_JACOBI : 1 : the halo_depth iterations between two exchanges are computed by a wavefront
+    real boundary[NB_EDGES]; // fixed values outside the matrix, on each edge (EDGE_BOTTOM, EDGE_TOP, EDGE_LEFT, EDGE_RIGHT, EDGE_FRONT, EDGE_BACK)
+    initial_guess initial;  // initial values of the significant data
+    real initial_value;    // value used by INITIAL_CONSTANT
+    const char *initial_file; // binary result file used by INITIAL_FILE
+    int verbosity;          // 0 : benchmark (no printing, no gather), 1 : production (errors and result file), 2 : debug (matrices printed)
+    int log_every;          // the errors are printed every log_every iterations (verbosity >= 1)
+    output_format format;   // format of the result file
+    const char *output;     // name of the result file (NULL : default name of the program)
+    int region[4];          // region of interest of the result file : first row, end row (excluded), first column, end column (whole matrix by default)
+    int output_stride;      // the result file has every output_stride rows and columns of the region (1 : all)
+    double compress_tolerance; // OUTPUT_COMPRESSED : maximal error of the values of the file (0 : lossless)
+    int snapshot_every;     // the view of the result file is also written every snapshot_every iterations, in the background (0 : never)
+    const char *checkpoint; // name of the checkpoint file (NULL : no checkpoint)
+    int checkpoint_every;   // a checkpoint is written every checkpoint_every iterations (0 : never)
+    double checkpoint_interval; // a checkpoint is written when the last one is older than checkpoint_interval seconds (0 : never)
+    int restart;            // 1 : the computation continues from the checkpoint file
+    int warmup;             // benchmark : number of computations before the measured ones (not reported)
+    int repeat;             // benchmark : number of measured computations (trials), 1 by default
+    const char *report;     // benchmark : file where the measures of the trials are appended (NULL : only printed)
+    report_format report_format; // format of the report file
+    int profile;            // 1 : the time of each phase of the iterations is printed for the processors (min, average, max)
+    int huge_pages;         // 1 : the large matrices are aligned on huge pages (transparent huge pages), see affinity.h
+    int affinity;           // 1 : the placement of the processors and threads is printed and checked at start
+    execution_backend backend; // BACKEND_CPU (default) or BACKEND_GPU (jacobi, gauss-seidel and sor)
+    int balance_every;      // the limits of the blocks follow the compute time of the processors, measured every balance_every iterations (0 : never)
+    const char *batch;      // file of the boundary values of the problems solved together (NULL : a single problem), see batch.h
+} solver_options;
+
+
+/**
+ * Returns 1 if the run is a benchmark : the computation is repeated (warm-up and trials) or reported
+ */
+int is_benchmark(const solver_options *options);
+
+
+/**
+ * Read the command line : [options] N
+ * Returns 0 if the options are valid, -1 otherwise (the processor me = 0 prints the error and the usage)
+ */
+int parse_options(int argc, char *argv[], int me, solver_options *options);
+
+
+#endif
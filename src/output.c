@@ -0,0 +1,370 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Output stage of laplace_1D and laplace_2D : views of the matrix, compressed files and snapshots (MPI-IO)
+
+Each processor copies its part of the view in a buffer and compresses it itself : the processors compress their blocks
+in parallel, and only the sizes of the compressed blocks are shared (MPI_Exscan gives the offset of each block in the file).
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "output.h"
+#include "timers.h"
+
+
+#if defined(LAPLACE_DOUBLE)
+typedef uint64_t real_bits;     // bits of a value (codec 1)
+#else
+typedef uint32_t real_bits;
+#endif
+#define MAX_VARINT_BYTES 10     // bytes of the varint of a 64 bits integer
+
+
+/**
+ * Print the MPI error message on the processor 0 and return -1
+ */
+static int output_error(MPI_Comm comm, const char *filename, const char *step, int error_code)
+{
+    int me, length;
+    char message[MPI_MAX_ERROR_STRING];
+    MPI_Comm_rank(comm, &me);
+    MPI_Error_string(error_code, message, &length);
+    if (me == 0) { printf("ERROR: %s %s: %s\n", step, filename, message); }
+    return -1;
+}
+
+
+void init_output_view(output_view *view, const solver_options *options)
+{
+    int stride = options->output_stride;
+    view->format = options->format;
+    view->first[0] = options->region[0];
+    view->first[1] = options->region[2];
+    view->sizes[0] = (options->region[1] - options->region[0] + stride-1)/stride;
+    view->sizes[1] = (options->region[3] - options->region[2] + stride-1)/stride;
+    view->stride = stride;
+    view->tolerance = options->compress_tolerance;
+}
+
+
+int is_whole_matrix(const output_view *view, int N)
+{
+    return (view->format == OUTPUT_BINARY || view->format == OUTPUT_RAW) && view->stride == 1
+           && view->first[0] == 0 && view->first[1] == 0 && view->sizes[0] == N && view->sizes[1] == N;
+}
+
+
+void indexed_filename(const char *filename, int index, char *buffer, int size)
+{
+    const char *slash = strrchr(filename, '/');
+    const char *dot = strrchr(filename, '.');
+    if (dot == NULL || (slash != NULL && dot < slash)) { dot = filename + strlen(filename); } // no extension
+    snprintf(buffer, size, "%.*s_%d%s", (int)(dot - filename), filename, index, dot);
+}
+
+
+/**
+ * Part of the view in my block, and buffers of its values
+ */
+static void locate_view(output_writer *writer)
+{
+    const output_view *view = &writer->view;
+    const block_layout *layout = &writer->layout;
+    for (int k = 0; k < 2; k++)
+    {
+        int first = layout->starts[k], end = layout->starts[k] + layout->sizes[k]; // my rows (columns) of the whole matrix
+        int view_end = view->first[k] + (view->sizes[k]-1)*view->stride + 1;
+        if (first < view->first[k]) { first = view->first[k]; }
+        if (end > view_end) { end = view_end; }
+        int start = (first - view->first[k] + view->stride-1)/view->stride; // first row (column) of the view in my block
+        int row = view->first[k] + start*view->stride;
+        writer->starts[k] = start;
+        writer->sizes[k] = (row < end) ? (end-1 - row)/view->stride + 1 : 0;
+        writer->local_first[k] = layout->local_starts[k] + row - layout->starts[k];
+    }
+    size_t nb_values = (size_t)writer->sizes[0]*writer->sizes[1];
+    writer->values = (real*)malloc((nb_values > 0 ? nb_values : 1)*sizeof(real));
+    writer->capacity = (view->format == OUTPUT_COMPRESSED) ? nb_values*MAX_VARINT_BYTES : 0;
+    writer->bytes = (writer->capacity > 0) ? (unsigned char*)malloc(writer->capacity) : NULL;
+    if (writer->values == NULL || (writer->capacity > 0 && writer->bytes == NULL)) { exit(-1); } // Check if the memory has been well allocated
+}
+
+
+void init_output_writer(output_writer *writer, const output_view *view, MPI_Comm comm, const block_layout *layout)
+{
+    writer->view = *view;
+    writer->comm = comm;
+    MPI_Comm_rank(comm, &writer->me);
+    MPI_Comm_size(comm, &writer->NPROC);
+    writer->layout = *layout;
+    writer->req = MPI_REQUEST_NULL;
+    writer->filename = NULL;
+    writer->failed = 0;
+    locate_view(writer);
+}
+
+
+/**
+ * Append the varint of value to bytes, returns the number of bytes written
+ */
+static size_t put_varint(unsigned char *bytes, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        bytes[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[n++] = (unsigned char)value;
+    return n;
+}
+
+
+/**
+ * Integer coded for a value : its bits as an ordered integer (codec 1), or its quantized value (codec 2, step > 0)
+ */
+static uint64_t value_integer(real value, double step)
+{
+    if (step > 0)
+    {
+        double steps = value/step;
+        if (!(fabs(steps) <= 0x1p62)) { steps = (steps < 0) ? -0x1p62 : 0x1p62; } // llround is undefined out of an int64 (value far beyond the tolerance checked by parse_options, or NaN)
+        return (uint64_t)llround(steps);
+    }
+    real_bits bits, sign = (real_bits)1 << (8*sizeof(real)-1);
+    memcpy(&bits, &value, sizeof(real));
+    bits = (bits & sign) ? ~bits : (bits | sign); // the order of the integers is the order of the values
+    return bits;
+}
+
+
+/**
+ * Datatype of nb_bytes contiguous bytes, any number of them (the counts of MPI are int) : whole chunks of OUTPUT_CHUNK_BYTES bytes,
+ * then the last bytes. To be freed by MPI_Type_free
+ */
+static MPI_Datatype bytes_type(long long nb_bytes)
+{
+    MPI_Datatype chunk, type;
+    MPI_Type_contiguous(OUTPUT_CHUNK_BYTES, MPI_BYTE, &chunk);
+    int lengths[2] = {(int)(nb_bytes / OUTPUT_CHUNK_BYTES), (int)(nb_bytes % OUTPUT_CHUNK_BYTES)};
+    MPI_Aint displacements[2] = {0, (MPI_Aint)lengths[0]*OUTPUT_CHUNK_BYTES};
+    MPI_Datatype types[2] = {chunk, MPI_BYTE};
+    MPI_Type_create_struct(2, lengths, displacements, types, &type);
+    MPI_Type_commit(&type);
+    MPI_Type_free(&chunk);
+    return type;
+}
+
+
+/**
+ * Code the rows x cols values in bytes (codec of the tolerance, see output.h), returns the size of the code
+ */
+static size_t compress_values(const real *values, int rows, int cols, double tolerance, unsigned char *bytes)
+{
+    uint64_t *integers = (uint64_t*)malloc(2*(size_t)(cols > 0 ? cols : 1)*sizeof(uint64_t)); // integers of the previous and of the current row
+    if (integers == NULL) { exit(-1); } // Check if the memory has been well allocated
+    size_t size = 0;
+    for (int i = 0; i < rows; i++)
+    {
+        uint64_t *above = integers + (size_t)((i+1)%2)*cols, *row = integers + (size_t)(i%2)*cols;
+        for (int j = 0; j < cols; j++)
+        {
+            row[j] = value_integer(values[(size_t)i*cols + j], 2*tolerance);
+            uint64_t prediction = 0; // Lorenzo predictor, modulo 2^64 : left + above - above left
+            if (j > 0) { prediction += row[j-1]; }
+            if (i > 0) { prediction += above[j]; }
+            if (i > 0 && j > 0) { prediction -= above[j-1]; }
+            int64_t d = (int64_t)(row[j] - prediction);
+            size += put_varint(bytes + size, ((uint64_t)d << 1) ^ (uint64_t)(d >> 63)); // zigzag : small residuals are small integers
+        }
+    }
+    free(integers);
+    return size;
+}
+
+
+/**
+ * Header and index of a compressed file (processor 0) from the index entries of all the processors
+ */
+static int write_compressed_header(output_writer *writer, const char *entries)
+{
+    const output_view *view = &writer->view;
+    char header[COMPRESSED_HEADER_SIZE];
+    int32_t values[9] = {FILE_VERSION, view->sizes[0], view->sizes[1], view->first[0], view->first[1], view->stride,
+                         view->tolerance == 0 ? CODEC_LOSSLESS : CODEC_QUANTIZED, writer->NPROC, 0}; // ..., codec, number of blocks, padding
+    memcpy(header, "LAPZ", 4);
+    memcpy(header+4, values, sizeof(values));
+    memcpy(header+40, &view->tolerance, sizeof(double));
+    int error_code = MPI_File_write_at(writer->file, 0, header, COMPRESSED_HEADER_SIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+    if (error_code == MPI_SUCCESS)
+    {
+        error_code = MPI_File_write_at(writer->file, COMPRESSED_HEADER_SIZE, (void*)entries, writer->NPROC*COMPRESSED_INDEX_SIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    return error_code;
+}
+
+
+int start_output(output_writer *writer, const char *filename, const real *local_tab)
+{
+    if (finish_output(writer) != 0) { return -1; } // one write in flight at most : a single copy of the values
+    const output_view *view = &writer->view;
+    const block_layout *layout = &writer->layout;
+    size_t nb_values = (size_t)writer->sizes[0]*writer->sizes[1];
+
+    // Copy of my part of the view : local_tab is modified by the next iterations during the write
+    timer_phase previous = timer_switch(TIMER_COPY);
+    int local_cols = layout->local_sizes[1], stride = view->stride;
+    for (int i = 0; i < writer->sizes[0]; i++)
+    {
+        const real *row = local_tab + (size_t)(writer->local_first[0] + i*stride)*local_cols + writer->local_first[1];
+        real *values = writer->values + (size_t)i*writer->sizes[1];
+        for (int j = 0; j < writer->sizes[1]; j++)
+        {
+            values[j] = row[(size_t)j*stride];
+        }
+    }
+    long long nb_bytes = 0;
+    if (view->format == OUTPUT_COMPRESSED)
+    {
+        nb_bytes = (long long)compress_values(writer->values, writer->sizes[0], writer->sizes[1], view->tolerance, writer->bytes);
+    }
+    timer_switch(previous);
+
+    writer->filename = (char*)malloc(strlen(filename)+1);
+    if (writer->filename == NULL) { exit(-1); } // Check if the memory has been well allocated
+    strcpy(writer->filename, filename);
+    int error_code = MPI_File_open(writer->comm, writer->filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &writer->file);
+    if (error_code != MPI_SUCCESS)
+    {
+        output_error(writer->comm, writer->filename, "output: MPI_File_open", error_code);
+        free(writer->filename);
+        writer->filename = NULL;
+        return -1;
+    }
+    MPI_File_set_size(writer->file, 0); // an older and bigger file is truncated
+
+    int header_code = MPI_SUCCESS; // processor 0 : the failure of the header is shared by finish_output
+    if (view->format == OUTPUT_COMPRESSED)
+    {
+        // Offset of my block after the blocks of the previous processors, and my entry of the index
+        long long offset = 0;
+        MPI_Exscan(&nb_bytes, &offset, 1, MPI_LONG_LONG, MPI_SUM, writer->comm);
+        if (writer->me == 0) { offset = 0; } // undefined on the processor 0
+        offset += COMPRESSED_HEADER_SIZE + (long long)writer->NPROC*COMPRESSED_INDEX_SIZE;
+        char entry[COMPRESSED_INDEX_SIZE];
+        int32_t position[4] = {writer->starts[0], writer->starts[1], writer->sizes[0], writer->sizes[1]};
+        int64_t data[2] = {offset, nb_bytes};
+        memcpy(entry, position, sizeof(position));
+        memcpy(entry+16, data, sizeof(data));
+        char *entries = (writer->me == 0) ? (char*)malloc((size_t)writer->NPROC*COMPRESSED_INDEX_SIZE) : NULL;
+        if (writer->me == 0 && entries == NULL) { exit(-1); } // Check if the memory has been well allocated
+        MPI_Gather(entry, COMPRESSED_INDEX_SIZE, MPI_BYTE, entries, COMPRESSED_INDEX_SIZE, MPI_BYTE, 0, writer->comm);
+        if (writer->me == 0) { header_code = write_compressed_header(writer, entries); }
+        free(entries);
+        MPI_Datatype block_bytes = bytes_type(nb_bytes); // more than 2^31 bytes for large blocks
+        error_code = MPI_File_iwrite_at_all(writer->file, offset, writer->bytes, 1, block_bytes, &writer->req); // completed by finish_output
+        MPI_Type_free(&block_bytes); // freed once the write completes
+    }
+    else
+    {
+        MPI_Offset displacement = 0;
+        if (view->format == OUTPUT_BINARY)
+        {
+            if (writer->me == 0)
+            {
+                char header[BINARY_HEADER_SIZE];
+                int32_t values[3] = {FILE_VERSION, view->sizes[0], view->sizes[1]}; // version, rows, columns
+                memcpy(header, "LAPL", 4);
+                memcpy(header+4, values, sizeof(values));
+                header_code = MPI_File_write_at(writer->file, 0, header, BINARY_HEADER_SIZE, MPI_BYTE, MPI_STATUS_IGNORE);
+            }
+            displacement = BINARY_HEADER_SIZE;
+        }
+        if (nb_values > 0) // file view of my part in the view
+        {
+            MPI_Datatype file_block;
+            MPI_Type_create_subarray(2, (int*)view->sizes, writer->sizes, writer->starts, MPI_ORDER_C, LAPLACE_MPI_REAL, &file_block);
+            MPI_Type_commit(&file_block);
+            MPI_File_set_view(writer->file, displacement, LAPLACE_MPI_REAL, file_block, "native", MPI_INFO_NULL);
+            MPI_Type_free(&file_block);
+        }
+        else // no value of the view in my block : I only take part in the collective write
+        {
+            MPI_File_set_view(writer->file, displacement, LAPLACE_MPI_REAL, LAPLACE_MPI_REAL, "native", MPI_INFO_NULL);
+        }
+        MPI_Datatype row; // a row of my part of the view : a count of rows, not of values (more than 2^31 values for large blocks)
+        MPI_Type_contiguous(writer->sizes[1], LAPLACE_MPI_REAL, &row);
+        MPI_Type_commit(&row);
+        error_code = MPI_File_iwrite_all(writer->file, writer->values, (nb_values > 0) ? writer->sizes[0] : 0, row, &writer->req); // completed by finish_output
+        MPI_Type_free(&row); // freed once the write completes
+    }
+    writer->failed = (header_code != MPI_SUCCESS);
+    if (error_code != MPI_SUCCESS)
+    {
+        MPI_File_close(&writer->file);
+        output_error(writer->comm, writer->filename, "output: MPI_File_iwrite_all", error_code);
+        free(writer->filename);
+        writer->filename = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+
+int finish_output(output_writer *writer)
+{
+    if (writer->filename == NULL) { return 0; }
+
+    int error_code = MPI_Wait(&writer->req, MPI_STATUS_IGNORE);
+    MPI_File_close(&writer->file);
+
+    int failed = (error_code != MPI_SUCCESS || writer->failed);
+    MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, writer->comm);
+    if (failed && writer->me == 0) { printf("ERROR: output: write of %s failed\n", writer->filename); }
+    free(writer->filename);
+    writer->filename = NULL;
+    return failed ? -1 : 0;
+}
+
+
+void resize_output_writer(output_writer *writer, const block_layout *layout)
+{
+    finish_output(writer);
+    free(writer->values);
+    free(writer->bytes);
+    writer->layout = *layout;
+    locate_view(writer);
+}
+
+
+void free_output_writer(output_writer *writer)
+{
+    finish_output(writer);
+    free(writer->values);
+    free(writer->bytes);
+}
+
+
+int write_output(const char *filename, MPI_Comm comm, const real *local_tab, const block_layout *layout, const solver_options *options)
+{
+    output_view view;
+    init_output_view(&view, options);
+    if (is_whole_matrix(&view, layout->global_sizes[0])) // straight from the local matrices (io.h)
+    {
+        return write_binary_matrix(filename, comm, local_tab, layout, view.format == OUTPUT_BINARY);
+    }
+    output_writer writer;
+    init_output_writer(&writer, &view, comm, layout);
+    int status = start_output(&writer, filename, local_tab);
+    if (status == 0) { status = finish_output(&writer); }
+    free_output_writer(&writer);
+    return status;
+}
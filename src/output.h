@@ -0,0 +1,136 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Output stage of laplace_1D and laplace_2D : views of the matrix (region of interest, downsampling), compressed files and snapshots
+
+The view of the matrix written is the region of interest (--output-region) read every stride rows and every stride columns
+(--output-stride) : each processor extracts its part of the view from its block, and writes it in parallel (MPI-IO).
+With the "binary" and "raw" formats, the view is a matrix of the binary file format of io.h (its rows and columns in the header).
+
+Compressed file format ("compressed" output) :
+    header of 48 bytes : "LAPZ" (4 characters), version (int32, 1 or 2 as the binary output : size of the values),
+    number of rows (int32), number of columns (int32) of the view, first row (int32), first column (int32) and stride (int32)
+    of the view in the whole matrix, codec (int32), number of blocks (int32), padding (int32), tolerance (float64)
+    then the index of the blocks, 32 bytes per block : first row (int32), first column (int32), rows (int32) and columns (int32)
+    of the block in the view, offset of its data in the file (int64), size of its data in bytes (int64)
+    then the data of the blocks : each processor compresses its own block, an integer x per value, row by row.
+    codec 1 (lossless, tolerance 0) : x is the bits of the value (uint32 or uint64, as the version) as an ordered integer :
+    all the bits inverted if the sign bit is set, the sign bit set otherwise (a larger x is a larger value)
+    codec 2 (lossy, tolerance > 0) : x = round(value / (2 tolerance)), the value read is x * 2 tolerance, within tolerance of the computed one
+    (the tolerance is at least the largest boundary or initial value / 2^53, see COMPRESS_MAX_STEPS)
+    x is coded as its difference d to the Lorenzo prediction from the previous values of the block : left + above - above left
+    (the left one only in the first row of the block, the above one only in its first column, 0 for its first value),
+    computed modulo 2^64, as a zigzag varint : (d << 1) ^ (d >> 63) with 7 bits per byte, the low bits first, the bit 0x80
+    of a byte set when more bytes follow. The values of a smooth field are well predicted : their d are small integers.
+
+Snapshots (--snapshot-every K) : every K iterations, the view of the values of the iteration is written in the result file name
+with _<iteration> before its extension (result_laplace_2D_500.bin), with the format of the result file. The values are copied
+(and compressed) before the write, which completes in the background during the next iterations (MPI_File_iwrite_all) :
+one snapshot is in flight at most.
+
+----------------------------------------------------------------------
+*/
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "mpi.h"
+#include "precision.h"
+#include "options.h"
+#include "io.h"
+
+#define COMPRESSED_HEADER_SIZE 48
+#define COMPRESSED_INDEX_SIZE 32           // index of a block
+#define CODEC_LOSSLESS 1
+#define CODEC_QUANTIZED 2
+#define OUTPUT_CHUNK_BYTES (1 << 20)       // the compressed blocks are written as chunks of 1 MiB (MPI counts are int)
+#define COMPRESS_MAX_STEPS 0x1p52          // largest |value| / (2 tolerance) of the boundary and initial values : x fits in an int64
+
+
+/**
+ * Part of the whole matrix written : every stride rows and columns of a region of interest
+ */
+typedef struct
+{
+    output_format format;   // OUTPUT_BINARY, OUTPUT_RAW or OUTPUT_COMPRESSED
+    int first[2];           // first row and first column of the view in the whole matrix
+    int sizes[2];           // rows and columns of the view
+    int stride;             // rows (columns) of the whole matrix between two rows (columns) of the view
+    double tolerance;       // OUTPUT_COMPRESSED : maximal error of the values read (0 : lossless)
+} output_view;
+
+
+/**
+ * Writer of views of the local matrices of a decomposition, in the background : my part of the view is copied (and compressed)
+ * in buffers, so that the solver can go on updating its local matrix during the write
+ */
+typedef struct
+{
+    output_view view;
+    MPI_Comm comm;
+    int me, NPROC;              // my rank in comm, number of processors
+    block_layout layout;        // position of my block in the whole matrix and in the local matrices written
+    int starts[2];              // position of my part of the view in the view (first row, first column)
+    int sizes[2];               // rows and columns of my part of the view (0 : my block has no value of the view)
+    int local_first[2];         // position of its first value in the local matrix
+    real *values;               // my part of the view, row by row
+    unsigned char *bytes;       // OUTPUT_COMPRESSED : my compressed part of the view
+    size_t capacity;            // size of bytes (the longest code of my values)
+    MPI_File file;
+    MPI_Request req;            // write in flight
+    char *filename;             // name of the file in flight (NULL : none)
+    int failed;                 // 1 : the header of the file in flight could not be written
+} output_writer;
+
+
+/**
+ * View of the whole matrix written with the options : --output-format, --output-region, --output-stride and --compress-tolerance
+ */
+void init_output_view(output_view *view, const solver_options *options);
+
+/**
+ * Returns 1 if the view is the whole matrix in the binary or raw format (written by write_binary_matrix of io.h), 0 otherwise
+ */
+int is_whole_matrix(const output_view *view, int N);
+
+/**
+ * Name of the file filename with _index before its extension (snapshots, problems of a batch), written in buffer
+ */
+void indexed_filename(const char *filename, int index, char *buffer, int size);
+
+/**
+ * Prepare the writes of the view of the local matrices described by layout (collective on comm)
+ */
+void init_output_writer(output_writer *writer, const output_view *view, MPI_Comm comm, const block_layout *layout);
+
+/**
+ * Start to write the view of local_tab in filename (collective) : the write in flight, if any, is completed first.
+ * Returns 0 on success, -1 otherwise (the processor 0 prints the error)
+ */
+int start_output(output_writer *writer, const char *filename, const real *local_tab);
+
+/**
+ * Complete the write in flight, if any (collective).
+ * Returns 0 on success, -1 otherwise (the processor 0 prints the error)
+ */
+int finish_output(output_writer *writer);
+
+/**
+ * Complete the write in flight, and prepare the next ones for the new block layout of my local matrix (load balancing)
+ */
+void resize_output_writer(output_writer *writer, const block_layout *layout);
+
+/**
+ * Complete the write in flight and release the buffers
+ */
+void free_output_writer(output_writer *writer);
+
+/**
+ * Write the view of the options of the local matrices of a 2D decomposition in filename, and wait for the end of the write (collective).
+ * Returns 0 on success, -1 otherwise (the processor 0 prints the error)
+ */
+int write_output(const char *filename, MPI_Comm comm, const real *local_tab, const block_layout *layout, const solver_options *options);
+
+
+#endif
@@ -0,0 +1,45 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Precision of the values, chosen at compile time for all the modules
+
+    default             float : single precision values, single precision updates
+    -DLAPLACE_DOUBLE    double : double precision values (matrices, adjacent values, files), double precision updates
+    -DLAPLACE_DOUBLE_CALC  double-calc : single precision values (half the memory traffic and messages of double),
+                        each new value of the stencil kernels computed in double precision from them, then rounded once.
+                        This is not a mixed precision refinement (no correction of the error in double precision) :
+                        the values, and so the results, are only as accurate as in the default float build
+
+The error sums and the scalar products are accumulated in double precision in all the modes.
+
+----------------------------------------------------------------------
+*/
+
+#ifndef PRECISION_H
+#define PRECISION_H
+
+
+#if defined(LAPLACE_DOUBLE) && defined(LAPLACE_DOUBLE_CALC)
+#error "LAPLACE_DOUBLE and LAPLACE_DOUBLE_CALC cannot be used together"
+#endif
+
+#if defined(LAPLACE_DOUBLE)
+typedef double real;            // values of the matrices
+typedef double real_calc;       // arithmetic of the stencil updates
+#define LAPLACE_MPI_REAL MPI_DOUBLE
+#define PRECISION_NAME "double"
+#elif defined(LAPLACE_DOUBLE_CALC)
+typedef float real;
+typedef double real_calc;
+#define LAPLACE_MPI_REAL MPI_FLOAT
+#define PRECISION_NAME "double-calc"
+#else
+typedef float real;
+typedef float real_calc;
+#define LAPLACE_MPI_REAL MPI_FLOAT
+#define PRECISION_NAME "float"
+#endif
+
+
+#endif
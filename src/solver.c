@@ -0,0 +1,593 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Iterations of the solvers on the local matrix of a decomposition : Jacobi (deep halos, wavefront), red-black Gauss-Seidel and SOR,
+multigrid and conjugate gradient
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "solver.h"
+#include "stencil.h"
+#include "multigrid.h"
+#include "timers.h"
+#include "affinity.h"
+#include "offload.h"
+#include "balance.h"
+#include "output.h"
+#include "norms.h"
+#include "convergence.h"
+
+
+/**
+ * CONJUGATE GRADIENT
+ * The laplace equation is the linear system A x = b, with A x = 4*x - neighbors on the SIGNIFICANT values and b the boundary values
+ * (adjacent data of local_tab outside the matrix). The vectors r (residual b - A x), z (preconditioned residual), w = A z,
+ * p (direction) and s = A p have the dimensions of a local matrix, their adjacent data outside the matrix stay at 0.
+ * Chronopoulos-Gear variant : s is updated by a recurrence (s = w + beta*s) instead of a product A p, so the scalar products
+ * of an iteration, (r,z), (w,z), (r,r) and (s,z), are all computed after the product w = A z and summed by a single MPI_Allreduce.
+ * beta is the Polak-Ribiere (flexible) coefficient (r - r_previous, z)/(r,z)_previous = -alpha * (s,z)/(r,z)_previous :
+ * equal to the classical one in exact arithmetic, it stays robust when the preconditioner is not exactly symmetric
+ * (the multigrid V-cycle, whose restriction is not the transpose of its prolongation).
+ * The error is 0.25 * |r| : the norm of the change that a Jacobi iteration would make, as for the other methods.
+ */
+#define CG_NB_SUMS 4        // scalar products of an iteration : (r,z), (w,z), (r,r), (s,z)
+#define CG_JACOBI_SWEEPS 4  // Jacobi iterations of PRECONDITIONER_JACOBI (the first one is z = r/4)
+
+
+/**
+ * State of the conjugate gradient between two iterations
+ */
+typedef struct
+{
+    halo_exchange *halo;            // exchange of the adjacent data of z before the product w = A z
+    cg_preconditioner preconditioner;
+    multigrid mg;                   // PRECONDITIONER_MULTIGRID : its level 0 solves A z = r
+    int nb_rows, nb_cols;           // dimensions of the local matrices
+    real *r, *z, *w, *p, *s;       // z is r itself without preconditioner
+    real *scratch;                 // PRECONDITIONER_JACOBI : values of the previous Jacobi iteration
+    double gamma;                   // (r,z) of the current residual
+    double ps;                      // (p,s) of the current direction
+    double alpha, beta;             // step along the direction p, and weight of the previous direction in the next one
+} conjugate_gradient;
+
+
+/**
+ * Allocate a vector of the conjugate gradient, set to 0
+ */
+static real *cg_vector(int nb_rows, int nb_cols)
+{
+    real *vector = alloc_matrix(nb_rows, nb_cols);
+    if (vector == NULL) { exit(-1); } // Check if the memory has been well allocated
+    return vector;
+}
+
+
+/**
+ * Preconditioned residual z, product w = A z, and the scalar products (r,z), (w,z), (r,r) and (s,z) of my block in local_sums
+ * (s : product of the previous direction)
+ */
+static void cg_precondition_and_multiply(conjugate_gradient *cg, double local_sums[CG_NB_SUMS])
+{
+    int last_row = cg->nb_rows-2;
+    int last_col = cg->nb_cols-2;
+    int nb_cols = cg->nb_cols;
+    double rz = 0, rr = 0, sz = 0;
+
+    if (cg->preconditioner == PRECONDITIONER_JACOBI)
+    {
+        for (int sweep = 0; sweep < CG_JACOBI_SWEEPS; sweep++) // z = 0.25 * (neighbors + r), from z = 0
+        {
+            if (sweep > 0) { update_matrix(cg->halo, cg->z); }
+            for (int i = 1; i <= last_row; i++)
+            {
+                for (int j = 1; j <= last_col; j++)
+                {
+                    const real *z = cg->z + j + i*nb_cols;
+                    real neighbors = (sweep > 0) ? z[nb_cols] + z[-nb_cols] + z[-1] + z[1] : 0.0f;
+                    cg->scratch[j+i*nb_cols] = 0.25f*(neighbors + cg->r[j+i*nb_cols]);
+                }
+            }
+            real *swap = cg->z; // the new values become the current ones (no copy)
+            cg->z = cg->scratch;
+            cg->scratch = swap;
+        }
+    }
+    else if (cg->preconditioner == PRECONDITIONER_MULTIGRID)
+    {
+        memset(cg->z, 0, cg->nb_rows*cg->nb_cols*sizeof(real));
+        multigrid_vcycle(&cg->mg, 0); // the level 0 solves A z = r
+    }
+
+    for (int i = 1; i <= last_row; i++)
+    {
+        for (int j = 1; j <= last_col; j++)
+        {
+            double r = cg->r[j+i*nb_cols];
+            double z = cg->z[j+i*nb_cols];
+            rz += r*z;
+            rr += r*r;
+            sz += (double)cg->s[j+i*nb_cols]*z;
+        }
+    }
+
+    update_matrix(cg->halo, cg->z);
+    local_sums[0] = rz;
+    local_sums[1] = stencil_laplacian(cg->z, cg->w, 1, last_row, 1, last_col, nb_cols);
+    local_sums[2] = rr;
+    local_sums[3] = sz;
+}
+
+
+/**
+ * Coefficients of the next iteration, from the global scalar products (r,z), (w,z), (r,r) and (s,z) (first : no previous direction).
+ * The next direction p = z + beta*p_previous has (p,s) = (w,z) + 2*beta*(s,z) + beta^2*(p,s)_previous, as A is symmetric.
+ */
+static void cg_update_coefficients(conjugate_gradient *cg, const double global_sums[CG_NB_SUMS], int first)
+{
+    double gamma = global_sums[0];
+    double delta = global_sums[1];
+    double sz = global_sums[3];
+    cg->beta = first ? 0 : -cg->alpha*sz/cg->gamma;
+    cg->ps = first ? delta : delta + 2*cg->beta*sz + cg->beta*cg->beta*cg->ps;
+    cg->alpha = (gamma > 0) ? gamma/cg->ps : 0; // r = 0 : exact solution, nothing more to do
+    cg->gamma = gamma;
+}
+
+
+/**
+ * Allocate the vectors of the conjugate gradient and compute the initial residual of the values local_tab (one reduction)
+ */
+static void init_conjugate_gradient(conjugate_gradient *cg, real *local_tab, int Nlocal_rows, int Nlocal_cols, halo_exchange *halo,
+                                    cg_preconditioner preconditioner, const block_layout *layout)
+{
+    int last_row = Nlocal_rows-2;
+    int last_col = Nlocal_cols-2;
+    cg->halo = halo;
+    cg->preconditioner = preconditioner;
+    cg->nb_rows = Nlocal_rows;
+    cg->nb_cols = Nlocal_cols;
+    cg->r = cg_vector(Nlocal_rows, Nlocal_cols);
+    cg->z = (preconditioner == PRECONDITIONER_NONE) ? cg->r : cg_vector(Nlocal_rows, Nlocal_cols);
+    cg->w = cg_vector(Nlocal_rows, Nlocal_cols);
+    cg->p = cg_vector(Nlocal_rows, Nlocal_cols);
+    cg->s = cg_vector(Nlocal_rows, Nlocal_cols);
+    cg->scratch = (preconditioner == PRECONDITIONER_JACOBI) ? cg_vector(Nlocal_rows, Nlocal_cols) : NULL;
+    if (preconditioner == PRECONDITIONER_MULTIGRID)
+    {
+        init_multigrid(&cg->mg, halo->comm, layout, cg->z, cg->r);
+    }
+
+    // r = b - A x : the product with the boundary values in the adjacent data of local_tab gives A x - b
+    update_matrix(halo, local_tab);
+    stencil_laplacian(local_tab, cg->r, 1, last_row, 1, last_col, Nlocal_cols);
+    for (int i = 1; i <= last_row; i++)
+    {
+        for (int j = 1; j <= last_col; j++)
+        {
+            cg->r[j+i*Nlocal_cols] = -cg->r[j+i*Nlocal_cols];
+        }
+    }
+
+    double local_sums[CG_NB_SUMS], global_sums[CG_NB_SUMS];
+    cg_precondition_and_multiply(cg, local_sums);
+    MPI_Allreduce(local_sums, global_sums, CG_NB_SUMS, MPI_DOUBLE, MPI_SUM, halo->comm);
+    cg_update_coefficients(cg, global_sums, 1);
+}
+
+
+/**
+ * Free the vectors of the conjugate gradient
+ */
+static void free_conjugate_gradient(conjugate_gradient *cg)
+{
+    if (cg->preconditioner == PRECONDITIONER_MULTIGRID)
+    {
+        free_multigrid(&cg->mg);
+    }
+    if (cg->z != cg->r) { free(cg->z); }
+    free(cg->r);
+    free(cg->w);
+    free(cg->p);
+    free(cg->s);
+    free(cg->scratch);
+}
+
+
+/**
+ * Local part of an iteration on the values x : new direction p = z + beta*p and its product s = w + beta*s,
+ * x += alpha*p and r -= alpha*s in the same loop, then the new z and w.
+ * local_sums receives the scalar products of my block, to be reduced before cg_update_coefficients.
+ */
+static void cg_iteration(conjugate_gradient *cg, real *x, double local_sums[CG_NB_SUMS])
+{
+    int nb_cols = cg->nb_cols;
+    real alpha = cg->alpha;
+    real beta = cg->beta;
+    for (int i = 1; i <= cg->nb_rows-2; i++)
+    {
+        for (int j = 1; j <= nb_cols-2; j++)
+        {
+            int k = j+i*nb_cols;
+            real p = cg->z[k] + beta*cg->p[k];
+            real s = cg->w[k] + beta*cg->s[k];
+            cg->p[k] = p;
+            cg->s[k] = s;
+            x[k] += alpha*p;
+            cg->r[k] -= alpha*s;
+        }
+    }
+    cg_precondition_and_multiply(cg, local_sums);
+}
+
+
+/**
+ * Number of iterations of the next wavefront after iter_count iterations : up to options->halo_depth (one exchange),
+ * stopping at the next iteration which is checkpointed or written in a snapshot, and at options->max_iter
+ */
+static int wavefront_steps(int iter_count, solver_options *options)
+{
+    for (int step = 1; step < options->halo_depth; step++)
+    {
+        int iter = iter_count + step;
+        if ((options->checkpoint_every > 0 && iter % options->checkpoint_every == 0) || (options->snapshot_every > 0 && iter % options->snapshot_every == 0)
+            || (options->max_iter > 0 && iter == options->max_iter))
+        {
+            return step;
+        }
+    }
+    return options->halo_depth;
+}
+
+
+/**
+ * Jacobi iteration (without the error) on the ring between the block [first_row..last_row] x [first_col..last_col]
+ * and the inner block [inner_first_row..inner_last_row] x [inner_first_col..inner_last_col] (included, not empty) :
+ * the rows above and under the inner block, then the columns on its left and on its right
+ */
+static void sweep_ring(const real *current, real *next, int first_row, int last_row, int first_col, int last_col,
+                       int inner_first_row, int inner_last_row, int inner_first_col, int inner_last_col, int nb_cols)
+{
+    stencil_sweep(current, next, first_row, inner_first_row-1, first_col, last_col, nb_cols, 0);
+    stencil_sweep(current, next, inner_last_row+1, last_row, first_col, last_col, nb_cols, 0);
+    stencil_sweep(current, next, inner_first_row, inner_last_row, first_col, inner_first_col-1, nb_cols, 0);
+    stencil_sweep(current, next, inner_first_row, inner_last_row, inner_last_col+1, last_col, nb_cols, 0);
+}
+
+
+void split_block(int first_row, int last_row, int first_col, int last_col, const int has_neighbor[4], stencil_region parts[5])
+{
+    int inner_first_row = first_row + has_neighbor[0], inner_last_row = last_row - has_neighbor[1];
+    int inner_first_col = first_col + has_neighbor[2], inner_last_col = last_col - has_neighbor[3];
+    stencil_region inner  = {inner_first_row, inner_last_row, inner_first_col, inner_last_col};
+    stencil_region above  = {first_row, inner_first_row-1 < last_row ? inner_first_row-1 : last_row, first_col, last_col};
+    stencil_region under  = {inner_last_row+1 > inner_first_row ? inner_last_row+1 : inner_first_row, last_row, first_col, last_col};
+    stencil_region left   = {inner_first_row, inner_last_row, first_col, inner_first_col-1 < last_col ? inner_first_col-1 : last_col};
+    stencil_region right  = {inner_first_row, inner_last_row, inner_last_col+1 > inner_first_col ? inner_last_col+1 : inner_first_col, last_col};
+    parts[0] = inner;
+    parts[1] = above;
+    parts[2] = under;
+    parts[3] = left;
+    parts[4] = right;
+}
+
+
+/**
+ * Copy the local matrix local_tab (block and its ADJACENT values) in the center of the matrix deep_tab, which has depth
+ * ADJACENT layers : outside the whole matrix, the boundary value of each edge is extended to the whole layer next to the block,
+ * so that the redundant iterations on the values of the neighbors (deep halo) read the boundary values too
+ */
+static void copy_to_deep_matrix(const real *local_tab, int Nlocal_rows, int Nlocal_cols, real *deep_tab, int depth, const int has_neighbor[4])
+{
+    int deep_rows = Nlocal_rows-2 + 2*depth;
+    int deep_cols = Nlocal_cols-2 + 2*depth;
+    for (int i = 0; i < Nlocal_rows; i++)
+    {
+        memcpy(deep_tab + (i+depth-1)*deep_cols + depth-1, local_tab + i*Nlocal_cols, Nlocal_cols*sizeof(real));
+    }
+    for (int k = 0; k < deep_cols; k++)
+    {
+        if (!has_neighbor[0]) { deep_tab[k + (depth-1)*deep_cols] = local_tab[1]; }
+        if (!has_neighbor[1]) { deep_tab[k + (deep_rows-depth)*deep_cols] = local_tab[1 + (Nlocal_rows-1)*Nlocal_cols]; }
+    }
+    for (int k = 0; k < deep_rows; k++)
+    {
+        if (!has_neighbor[2]) { deep_tab[(depth-1) + k*deep_cols] = local_tab[Nlocal_cols]; }
+        if (!has_neighbor[3]) { deep_tab[(deep_cols-depth) + k*deep_cols] = local_tab[2*Nlocal_cols-1]; }
+    }
+}
+
+
+int laplace(real **matrix, processor_grid *grid, solver_options *options, int first_iter)
+{
+    if (options->backend == BACKEND_GPU)
+    {
+        return laplace_offload(*matrix, grid, options, first_iter);
+    }
+    real *local_tab = *matrix;
+    int me = grid->me;
+    int Nlocal_rows = grid->Nlocal_rows, Nlocal_cols = grid->Nlocal_cols;
+    halo_exchange *halo = &grid->halo;
+    const block_layout *layout = &grid->layout;
+    const int *has_neighbor = grid->has_neighbor; // above, under, left, right
+    int depth = options->halo_depth;
+    int block_rows = Nlocal_rows-2, block_cols = Nlocal_cols-2;
+
+    real *current = local_tab; // values of the previous iteration
+    real *new_tab = NULL;      // temporary tab to store new values of local_tab (Jacobi only, the red-black methods are in place)
+    real *deep_tab = NULL;     // deep halo : local_tab with depth adjacent layers
+    halo_exchange deep_halo;
+    halo_exchange *exchange = halo; // exchange of the adjacent data of the Jacobi buffers
+    block_layout deep_layout = *layout;
+    int deep_cols = Nlocal_cols;
+    if (options->method == METHOD_JACOBI && depth > 1)
+    {
+        deep_cols = block_cols + 2*depth;
+        int deep_rows = block_rows + 2*depth;
+        deep_tab = alloc_matrix(deep_rows, deep_cols);
+        new_tab = alloc_matrix(deep_rows, deep_cols);
+        if (deep_tab == NULL || new_tab == NULL) { exit(-1); } // Check if the memory has been well allocated
+        timer_switch(TIMER_COPY);
+        copy_to_deep_matrix(local_tab, Nlocal_rows, Nlocal_cols, deep_tab, depth, has_neighbor);
+        copy_matrix(new_tab, deep_tab, deep_rows, deep_cols); // same adjacent values as deep_tab
+        timer_switch(TIMER_OTHER);
+        init_deep_halo_exchange(&deep_halo, halo->comm, block_rows + 2*depth, deep_cols, depth);
+        exchange = &deep_halo;
+        current = deep_tab;
+        for (int k = 0; k < 2; k++)
+        {
+            deep_layout.local_sizes[k] = layout->sizes[k] + 2*depth;
+            deep_layout.local_starts[k] = depth;
+        }
+    }
+    else if (options->method == METHOD_JACOBI)
+    {
+        new_tab = alloc_matrix(Nlocal_rows, Nlocal_cols);
+        if (new_tab == NULL) { exit(-1); } // Check if the memory has been well allocated
+        timer_switch(TIMER_COPY);
+        copy_matrix(new_tab, local_tab, Nlocal_rows, Nlocal_cols); // same adjacent values as local_tab
+        timer_switch(TIMER_OTHER);
+    }
+    real *next = new_tab;      // values computed by this iteration
+
+    stencil_region parts[5]; // inner block and outer ring of my block, computed before and after the arrival of the adjacent data
+    split_block(depth, depth + block_rows-1, depth, depth + block_cols-1, has_neighbor, parts);
+
+    stencil_region *regions = NULL; // wavefront : regions of the iterations between two exchanges
+    if (options->wavefront)
+    {
+        regions = (stencil_region*)malloc(depth*sizeof(stencil_region));
+        if (regions == NULL) { exit(-1); } // Check if the memory has been well allocated
+    }
+    if (options->method == METHOD_JACOBI)
+    {
+        int tile_cols = options->tile_cols;
+        if (tile_cols == TILE_COLS_AUTO)
+        {
+            tile_cols = stencil_tune_tile_cols(current, next, depth, depth+block_rows-1, depth, depth+block_cols-1, deep_cols);
+        }
+        stencil_set_tile_cols(tile_cols);
+        if (me == 0 && options->verbosity >= 1 && options->tile_cols != 0)
+        {
+            printf("Column strips of the sweeps (processor 0): %d columns%s\n", tile_cols, tile_cols == 0 ? " (whole rows)" : "");
+        }
+    }
+
+    int iter_count = first_iter;
+    int last_row = Nlocal_rows-2; // last significant row
+    int last_col = Nlocal_cols-2; // last significant column
+
+    int with_norms = uses_change_norms(options); // the error is a norm of norms.h, computed by a pass of its own
+    change_norms local_norms; // norms of my block
+    real *previous = NULL; // red-black methods with the norms : the values before the iteration
+    if (with_norms && (options->method == METHOD_GAUSS_SEIDEL || options->method == METHOD_SOR))
+    {
+        previous = alloc_matrix(Nlocal_rows, Nlocal_cols);
+        if (previous == NULL) { exit(-1); } // Check if the memory has been well allocated
+    }
+
+    multigrid mg;
+    if (options->method == METHOD_MULTIGRID)
+    {
+        init_multigrid(&mg, halo->comm, layout, local_tab, NULL);
+    }
+    conjugate_gradient cg;
+    if (options->method == METHOD_CG)
+    {
+        init_conjugate_gradient(&cg, local_tab, Nlocal_rows, Nlocal_cols, halo, options->preconditioner, layout);
+    }
+
+    convergence_monitor monitor; // reduction of the error, checkpoints and snapshots of current
+    init_convergence(&monitor, options, halo->comm, &deep_layout); // position of the block in current
+
+    timer_switch(TIMER_COMPUTE); // the setup above is charged to TIMER_OTHER
+    load_balancer balancer;
+    init_load_balancer(&balancer);
+    while(!is_converged(&monitor) && (options->max_iter == 0 || iter_count < options->max_iter)) // while the error is not as accurated as we want (tolerance), we continue the loop
+    {
+        double local_error_sum = 0;
+        int nb_steps = options->wavefront ? wavefront_steps(iter_count, options) : 1; // iterations computed by this pass of the loop
+        iter_count += nb_steps;
+        // The error is only needed for the convergence check : a wavefront is checked (its last iteration) if one of its iterations should be
+        int with_check = (options->method != METHOD_CG && iter_count/options->check_every > (iter_count-nb_steps)/options->check_every);
+        int with_error = with_check && !with_norms; // the kernels sum the squared changes
+
+        if (options->method == METHOD_JACOBI && options->wavefront)
+        {
+            // Temporal blocking : the iterations until the next exchange, the iteration s computes the nb_steps-1-s first layers
+            // of the values of my neighbors (its region shrinks by a layer at each iteration, down to my block)
+            update_matrix(exchange, current);
+            for (int step = 0; step < nb_steps; step++)
+            {
+                int extension = nb_steps-1 - step;
+                regions[step].first_row = depth - has_neighbor[0]*extension;
+                regions[step].last_row  = depth + block_rows-1 + has_neighbor[1]*extension;
+                regions[step].first_col = depth - has_neighbor[2]*extension;
+                regions[step].last_col  = depth + block_cols-1 + has_neighbor[3]*extension;
+            }
+            local_error_sum += stencil_wavefront(current, next, nb_steps, regions, deep_cols, with_error);
+            if (nb_steps % 2 == 1) // the final values are in next
+            {
+                real *swap = current;
+                current = next;
+                next = swap;
+            }
+        }
+        else if (options->method == METHOD_JACOBI)
+        {
+            int phase = (iter_count - first_iter - 1) % depth; // iterations since the last exchange
+            int first = depth, last_r = depth + block_rows-1, last_c = depth + block_cols-1; // my block in current
+            if (phase == 0)
+            {
+                start_update_matrix(exchange, current); // refresh the adjacent data in the background
+                local_error_sum += stencil_sweep(current, next, parts[0].first_row, parts[0].last_row, parts[0].first_col, parts[0].last_col, deep_cols, with_error); // inner block, no adjacent data needed
+                wait_update_matrix(exchange);
+
+                for (int p = 1; p < 5; p++) // outer ring of the significant values
+                {
+                    local_error_sum += stencil_sweep(current, next, parts[p].first_row, parts[p].last_row, parts[p].first_col, parts[p].last_col, deep_cols, with_error);
+                }
+            }
+            else
+            {
+                local_error_sum += stencil_sweep(current, next, first, last_r, first, last_c, deep_cols, with_error);
+            }
+
+            // Deep halo : values of the neighbors needed by the next iterations before the next exchange (not in the error)
+            int extension = depth-1 - phase;
+            if (extension > 0)
+            {
+                sweep_ring(current, next, first - has_neighbor[0]*extension, last_r + has_neighbor[1]*extension,
+                           first - has_neighbor[2]*extension, last_c + has_neighbor[3]*extension,
+                           first, last_r, first, last_c, deep_cols);
+            }
+
+            // The new values become the current ones (no copy)
+            real *swap = current;
+            current = next;
+            next = swap;
+        }
+        else if (options->method == METHOD_MULTIGRID)
+        {
+            multigrid_vcycle(&mg, 0);
+            if (with_check)
+            {
+                update_matrix(halo, current);
+                local_error_sum += stencil_sweep(current, mg.levels[0].r, 1, last_row, 1, last_col, Nlocal_cols, with_error); // Jacobi values in the scratch values
+            }
+        }
+        else if (options->method == METHOD_CG)
+        {
+            double local_sums[CG_NB_SUMS+1], global_sums[CG_NB_SUMS+1]; // scalar products, checkpoint needed (time)
+            cg_iteration(&cg, current, local_sums);
+            local_sums[CG_NB_SUMS] = checkpoint_interval_elapsed(&monitor.checkpoint, options->checkpoint_interval);
+            timer_switch(TIMER_REDUCTION);
+            MPI_Allreduce( local_sums, global_sums, CG_NB_SUMS+1, MPI_DOUBLE, MPI_SUM, halo->comm ); // the only reduction of the iteration
+            timer_switch(TIMER_COMPUTE);
+            cg_update_coefficients(&cg, global_sums, 0);
+
+            set_convergence_error(&monitor, iter_count, 0.25*sqrt(global_sums[2]), global_sums[CG_NB_SUMS]);
+        }
+        else
+        {
+            real omega = options->omega;
+            if (with_check && with_norms) { copy_matrix(previous, current, Nlocal_rows, Nlocal_cols); }
+            for (int color = 0; color < 2; color++) // red cells, then black cells
+            {
+                int parity = (color + layout->starts[0] + layout->starts[1]) & 1; // the local cell (i,j) is the cell (first_row+i-1, first_col+j-1) of the whole matrix
+                start_update_matrix(halo, current); // adjacent data of the other colour
+                local_error_sum += stencil_relax_color(current, NULL, parts[0].first_row, parts[0].last_row, parts[0].first_col, parts[0].last_col, Nlocal_cols, parity, omega, with_error); // inner block
+                wait_update_matrix(halo);
+
+                for (int p = 1; p < 5; p++) // outer ring
+                {
+                    local_error_sum += stencil_relax_color(current, NULL, parts[p].first_row, parts[p].last_row, parts[p].first_col, parts[p].last_col, Nlocal_cols, parity, omega, with_error);
+                }
+            }
+        }
+
+        if (with_check && with_norms) // old and new values of my block
+        {
+            clear_change_norms(&local_norms);
+            const real *old_values = (options->method == METHOD_JACOBI) ? next : (options->method == METHOD_MULTIGRID) ? current : previous;
+            const real *new_values = (options->method == METHOD_MULTIGRID) ? mg.levels[0].r : current; // jacobi : after the swap
+            add_change_norms(&local_norms, old_values, new_values, depth, depth + block_rows-1, depth, depth + block_cols-1, deep_cols, options->deterministic);
+        }
+
+        if (wait_convergence_check(&monitor)) { break; } // the error of a previous iteration has been reduced during this one
+        if (with_check)
+        {
+            check_convergence(&monitor, iter_count, local_error_sum, &local_norms);
+        }
+
+        if (options->balance_every > 0 && iter_count % options->balance_every == 0 && !is_converged(&monitor)
+            && (options->max_iter == 0 || iter_count < options->max_iter)) // not after the last iteration
+        {
+            timer_switch(TIMER_OTHER);
+            if (balance_load(&balancer, grid, &current, iter_count, options->verbosity)) // current is the local matrix of my new block
+            {
+                Nlocal_rows = grid->Nlocal_rows;
+                Nlocal_cols = deep_cols = grid->Nlocal_cols;
+                block_rows = last_row = Nlocal_rows-2;
+                block_cols = last_col = Nlocal_cols-2;
+                split_block(1, block_rows, 1, block_cols, has_neighbor, parts);
+                deep_layout = *layout;
+                resize_convergence(&monitor, layout);
+                if (previous != NULL)
+                {
+                    free(previous);
+                    previous = alloc_matrix(Nlocal_rows, Nlocal_cols);
+                    if (previous == NULL) { exit(-1); } // Check if the memory has been well allocated
+                }
+                if (options->method == METHOD_JACOBI)
+                {
+                    free(next);
+                    new_tab = next = alloc_matrix(Nlocal_rows, Nlocal_cols);
+                    if (new_tab == NULL) { exit(-1); } // Check if the memory has been well allocated
+                    copy_matrix(new_tab, current, Nlocal_rows, Nlocal_cols); // same adjacent values as current
+                }
+                local_tab = *matrix = current;
+            }
+            timer_switch(TIMER_COMPUTE);
+        }
+
+        save_convergence_outputs(&monitor, current, iter_count);
+    }
+    timer_switch(TIMER_OTHER);
+    finish_convergence(&monitor, current, iter_count);
+    if (options->method == METHOD_MULTIGRID)
+    {
+        free_multigrid(&mg);
+    }
+    if (options->method == METHOD_CG)
+    {
+        free_conjugate_gradient(&cg);
+    }
+    timer_switch(TIMER_COPY);
+    if (deep_tab != NULL) // the final values go back to local_tab
+    {
+        for (int i = 1; i <= block_rows; i++)
+        {
+            memcpy(local_tab + i*Nlocal_cols + 1, current + (i+depth-1)*deep_cols + depth, block_cols*sizeof(real));
+        }
+        current = local_tab;
+        free_halo_exchange(&deep_halo);
+        free(deep_tab);
+    }
+    update_matrix (halo, current); // the adjacent data match the final values
+    if (current != local_tab)
+    {
+        copy_matrix(local_tab, current, Nlocal_rows, Nlocal_cols); // a single copy when the final values are in new_tab
+    }
+    timer_switch(TIMER_OTHER);
+    free(new_tab);
+    free(regions);
+    free(previous);
+    return iter_count - first_iter;
+}
@@ -0,0 +1,57 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Solvers of the laplace equation, shared by all the decompositions
+
+----------------------------------------------------------------------
+*/
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "precision.h"
+#include "options.h"
+#include "grid.h"
+#include "stencil.h"
+
+
+/**
+ * Compute the laplacian equation on the local matrix local_tab of the decomposition grid
+ * The adjacent data are exchanged while the inner block (which does not need them) is computed,
+ * the outer ring of significant values is computed once the messages have arrived.
+ * Jacobi : two buffers swap their roles at each iteration (current values / new values) : both keep the edge values
+ * of the initial local_tab, and the adjacent data of the current one are refreshed before they are read.
+ * With options->halo_depth = k > 1, the buffers have k adjacent layers, exchanged every k iterations only (deep halo) :
+ * the iteration number p after an exchange also computes the k-1-p first layers of the values of my neighbors,
+ * which the next iteration needs. Each cell gets exactly the value computed by its owner, so the result does not depend on k.
+ * Gauss-Seidel and SOR : the red cells ((i+j)%2 == 0 in the whole matrix), then the black ones are updated in local_tab,
+ * with an exchange of the adjacent data before each colour.
+ * Multigrid : each iteration is a V-cycle on local_tab, the error is the one of a Jacobi iteration from its result.
+ * Conjugate gradient : local_tab is the approximate solution x, its error is computed by the single reduction of each iteration
+ * (options->check_every and options->async_check are not used). After a restart, the directions start again from the residual.
+ * The error is only computed and reduced every options->check_every iterations ; with options->async_check,
+ * its reduction (MPI_Iallreduce) overlaps the next iteration, which is then computed even if the loop stops.
+ * With options->norm (not NORM_L2) or options->deterministic, the error is the norm of the change of norms.h, computed by a pass
+ * of its own after the iteration and reduced with one user-defined operation, instead of the sum of the squared changes of the kernels.
+ * With options->checkpoint, the current values are written in the background every options->checkpoint_every iterations
+ * or options->checkpoint_interval seconds (the processor 0 measures the time, its decision is added to the reduction of the error),
+ * and when the maximum number of iterations is reached. The iterations are counted from first_iter (restart).
+ * With options->balance_every (jacobi, gauss-seidel and sor with a halo depth of 1), the limits of the blocks follow the compute time
+ * of the processors (balance.h) : grid then describes the new blocks and *local_tab is a new local matrix.
+ * At the end, *local_tab contains the final values (and up-to-date adjacent data).
+ * The time of the iterations is charged to the phases of timers.h. Returns the number of iterations computed.
+ */
+int laplace(real **local_tab, processor_grid *grid, solver_options *options, int first_iter);
+
+
+/**
+ * Split the block [first_row..last_row] x [first_col..last_col] for the overlap of an exchange : parts[0] is the inner block,
+ * which does not read the adjacent data of the neighbors, parts[1..4] the rows above and under it and the columns on its left
+ * and on its right (each cell in one part only, some parts may be empty). On an edge without neighbor, the adjacent values
+ * are the boundary values, which do not change : the inner block goes up to this edge (whole rows for the slab decomposition).
+ */
+void split_block(int first_row, int last_row, int first_col, int last_col, const int has_neighbor[4], stencil_region parts[5]);
+
+
+#endif
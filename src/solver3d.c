@@ -0,0 +1,168 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Iterations of the 3D solvers on the local matrix of a Cartesian decomposition : Jacobi, red-black Gauss-Seidel and SOR
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "solver3d.h"
+#include "stencil.h"
+#include "timers.h"
+#include "affinity.h"
+#include "convergence.h"
+
+
+/**
+ * Box of cells [first[0]..last[0]] x [first[1]..last[1]] x [first[2]..last[2]] (included) of a local matrix : planes, rows, columns
+ */
+typedef struct
+{
+    int first[3];
+    int last[3];
+} stencil_box;
+
+
+/**
+ * Split the box of the significant values for the overlap of an exchange, as split_block in 2D : parts[0] is the inner box,
+ * which does not read the adjacent faces, parts[1..6] the slabs before and after it in each dimension (each cell in one part only,
+ * some parts may be empty). The slabs of the dimension d cover the inner range of the dimensions before d, and the whole range
+ * of the dimensions after d. On a face without neighbor, the inner box goes up to this face.
+ */
+static void split_box(const stencil_box *block, const int has_neighbor[6], stencil_box parts[7])
+{
+    stencil_box inner;
+    for (int d = 0; d < 3; d++)
+    {
+        inner.first[d] = block->first[d] + has_neighbor[2*d];
+        inner.last[d]  = block->last[d]  - has_neighbor[2*d+1];
+    }
+    parts[0] = inner;
+    for (int d = 0; d < 3; d++)
+    {
+        stencil_box before = *block, after = *block;
+        for (int e = 0; e < d; e++)
+        {
+            before.first[e] = after.first[e] = inner.first[e];
+            before.last[e]  = after.last[e]  = inner.last[e];
+        }
+        before.last[d] = inner.first[d]-1 < block->last[d] ? inner.first[d]-1 : block->last[d];
+        after.first[d] = inner.last[d]+1 > inner.first[d] ? inner.last[d]+1 : inner.first[d];
+        parts[1+2*d] = before;
+        parts[2+2*d] = after;
+    }
+}
+
+
+/**
+ * Jacobi iteration on a box of the local matrix (nb_values[0] x nb_values[1] x nb_values[2] values)
+ */
+static double sweep_box(const real *current, real *next, const stencil_box *box, const int nb_values[3], int with_error)
+{
+    return stencil_sweep_3d(current, next, box->first[0], box->last[0], box->first[1], box->last[1], box->first[2], box->last[2],
+                            nb_values[1], nb_values[2], with_error);
+}
+
+
+/**
+ * Red-black half-sweep on a box of the local matrix (nb_values[0] x nb_values[1] x nb_values[2] values)
+ */
+static double relax_box(real *tab, const stencil_box *box, const int nb_values[3], int parity, real omega, int with_error)
+{
+    return stencil_relax_color_3d(tab, box->first[0], box->last[0], box->first[1], box->last[1], box->first[2], box->last[2],
+                                  nb_values[1], nb_values[2], parity, omega, with_error);
+}
+
+
+int laplace_3d(real *local_tab, processor_grid_3d *grid, solver_options *options, int first_iter)
+{
+    const int *Nlocal = grid->Nlocal;
+    halo_exchange *halo = &grid->halo;
+    const block_layout *layout = &grid->layout;
+
+    real *current = local_tab; // values of the previous iteration
+    real *new_tab = NULL;      // temporary tab to store new values of local_tab (Jacobi only, the red-black methods are in place)
+    if (options->method == METHOD_JACOBI)
+    {
+        new_tab = alloc_matrix(Nlocal[0]*Nlocal[1], Nlocal[2]);
+        if (new_tab == NULL) { exit(-1); } // Check if the memory has been well allocated
+        timer_switch(TIMER_COPY);
+        copy_matrix(new_tab, local_tab, Nlocal[0]*Nlocal[1], Nlocal[2]); // same adjacent values as local_tab
+        timer_switch(TIMER_OTHER);
+    }
+    real *next = new_tab;      // values computed by this iteration
+
+    stencil_box block = { {1, 1, 1}, {Nlocal[0]-2, Nlocal[1]-2, Nlocal[2]-2} }; // significant values
+    stencil_box parts[7]; // inner box and outer shell of my box, computed before and after the arrival of the adjacent faces
+    split_box(&block, grid->has_neighbor, parts);
+
+    int iter_count = first_iter;
+    convergence_monitor monitor; // reduction of the error and checkpoints
+    init_convergence(&monitor, options, halo->comm, layout);
+
+    timer_switch(TIMER_COMPUTE); // the setup above is charged to TIMER_OTHER
+    while(!is_converged(&monitor) && (options->max_iter == 0 || iter_count < options->max_iter))
+    {
+        double local_error_sum = 0;
+        iter_count++;
+        int with_error = (iter_count % options->check_every == 0); // the error is only needed for the convergence check
+
+        if (options->method == METHOD_JACOBI)
+        {
+            start_update_matrix(halo, current); // refresh the adjacent faces in the background
+            local_error_sum += sweep_box(current, next, &parts[0], Nlocal, with_error); // inner box, no adjacent face needed
+            wait_update_matrix(halo);
+
+            for (int p = 1; p < 7; p++) // outer shell of the significant values
+            {
+                local_error_sum += sweep_box(current, next, &parts[p], Nlocal, with_error);
+            }
+
+            // The new values become the current ones (no copy)
+            real *swap = current;
+            current = next;
+            next = swap;
+        }
+        else
+        {
+            real omega = options->omega;
+            for (int color = 0; color < 2; color++) // red cells, then black cells
+            {
+                // the local cell (k,i,j) is the cell (first_plane+k-1, first_row+i-1, first_col+j-1) of the whole matrix
+                int parity = (color + layout->starts[0] + layout->starts[1] + layout->starts[2] + 1) & 1;
+                start_update_matrix(halo, current); // adjacent faces of the other colour
+                local_error_sum += relax_box(current, &parts[0], Nlocal, parity, omega, with_error); // inner box
+                wait_update_matrix(halo);
+
+                for (int p = 1; p < 7; p++) // outer shell
+                {
+                    local_error_sum += relax_box(current, &parts[p], Nlocal, parity, omega, with_error);
+                }
+            }
+        }
+
+        if (wait_convergence_check(&monitor)) { break; } // the error of a previous iteration has been reduced during this one
+        if (with_error)
+        {
+            check_convergence(&monitor, iter_count, local_error_sum, NULL);
+        }
+        save_convergence_outputs(&monitor, current, iter_count);
+    }
+    timer_switch(TIMER_OTHER);
+    finish_convergence(&monitor, current, iter_count);
+    update_matrix (halo, current); // the adjacent faces match the final values
+    timer_switch(TIMER_COPY);
+    if (current != local_tab)
+    {
+        copy_matrix(local_tab, current, Nlocal[0]*Nlocal[1], Nlocal[2]); // a single copy when the final values are in new_tab
+    }
+    timer_switch(TIMER_OTHER);
+    free(new_tab);
+    return iter_count - first_iter;
+}
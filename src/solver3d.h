@@ -0,0 +1,33 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Solvers of the 3D laplace equation (laplace_3D) : Jacobi, red-black Gauss-Seidel and SOR with the 7-point stencil
+
+----------------------------------------------------------------------
+*/
+
+#ifndef SOLVER3D_H
+#define SOLVER3D_H
+
+#include "precision.h"
+#include "options.h"
+#include "grid3d.h"
+
+
+/**
+ * Compute the 3D laplacian equation on the local matrix local_tab of the decomposition grid, as laplace() in 2D :
+ * the 6 faces are exchanged while the inner box (which does not need them) is computed, the outer shell of significant values
+ * is computed once the messages have arrived.
+ * Jacobi : two buffers swap their roles at each iteration (current values / new values).
+ * Gauss-Seidel and SOR : the red cells ((k+i+j)%2 == 0 in the whole matrix), then the black ones are updated in local_tab,
+ * with an exchange of the adjacent faces before each colour.
+ * The convergence checks (options->check_every, options->async_check), the printing of the error and the checkpoints
+ * are the ones of the 2D solvers. The iterations are counted from first_iter (restart).
+ * At the end, local_tab contains the final values (and up-to-date adjacent faces).
+ * The time of the iterations is charged to the phases of timers.h. Returns the number of iterations computed.
+ */
+int laplace_3d(real *local_tab, processor_grid_3d *grid, solver_options *options, int first_iter);
+
+
+#endif
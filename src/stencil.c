@@ -0,0 +1,580 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Jacobi and red-black (Gauss-Seidel, SOR) stencil kernels and the laplacian operator (conjugate gradient), shared by all the decompositions
+
+The interior of a block has no branch : the edge effects are handled by the adjacent values.
+Cache blocking : stencil_sweep can compute the columns in strips (spatial blocking, stencil_set_tile_cols),
+and stencil_wavefront computes several iterations row by row (temporal blocking, with the deep halos).
+With OpenMP (mpicc -fopenmp), the rows of a block are shared between the threads of the processor.
+The SIMD versions compute exactly the same new values as the scalar one (same order of the additions) ;
+only the order of the additions of the error sum changes. The double and double-calc builds (precision.h)
+have their own SIMD versions, which compute in double precision (4 values per AVX2 vector, 8 per AVX-512 vector).
+The red-black kernels only update one cell out of two on each row : they are left to the compiler (scalar code),
+as the laplacian operator, whose scalar product is summed in double precision, and the 3D kernels (7-point stencil, laplace_3D).
+The batch kernels (interleaved problems, batch.h) loop over the problems innermost : the compiler vectorizes this loop.
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stencil.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STENCIL_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(LAPLACE_DOUBLE) || defined(LAPLACE_DOUBLE_CALC)
+#define STENCIL_DOUBLE_CALC 1 // the updates are computed in double precision (precision.h)
+#endif
+
+
+#define STENCIL_MIN_TILE_COLS 64          // narrowest strip tried by stencil_tune_tile_cols
+#define STENCIL_TUNING_SWEEPS 3           // sweeps timed for each width
+
+typedef double (*sweep_function)(const real *, real *, int, int, int, int, int, int);
+
+
+/**
+ * Scalar version of the kernel, for the remainder of the vector loops and the processors without SIMD support
+ */
+static double sweep_scalar_row(const real *current, real *next, int i, int first_col, int last_col, int nb_cols, int with_error)
+{
+    double local_error_sum = 0;
+    for (int j = first_col; j <= last_col; j++)
+    {
+        real_calc top_neighbor     = current[j+(i-1)*nb_cols];
+        real_calc bottom_neighbor  = current[j+(i+1)*nb_cols];
+        real_calc left_neighbor    = current[(j-1)+i*nb_cols];
+        real_calc right_neighbor   = current[(j+1)+i*nb_cols];
+
+        real_calc new_value = (real_calc)0.25*(bottom_neighbor + top_neighbor + left_neighbor + right_neighbor); // laplace equation formula
+        real_calc diff = new_value - current[j+i*nb_cols];
+
+        next[j+i*nb_cols] = new_value;
+        if (with_error) { local_error_sum += diff*diff; }
+    }
+    return local_error_sum;
+}
+
+
+static double sweep_scalar(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols, int with_error)
+{
+    double local_error_sum = 0;
+    for (int i = first_row; i <= last_row; i++)
+    {
+        local_error_sum += sweep_scalar_row(current, next, i, first_col, last_col, nb_cols, with_error);
+    }
+    return local_error_sum;
+}
+
+
+#if defined(STENCIL_X86) && !defined(STENCIL_DOUBLE_CALC)
+
+/**
+ * AVX2 version : 8 values per iteration, the squared differences are converted to double and summed in 2 vectors of 4 doubles
+ */
+__attribute__((target("avx2")))
+static double sweep_avx2(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols, int with_error)
+{
+    double local_error_sum = 0;
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+
+    for (int i = first_row; i <= last_row; i++)
+    {
+        const real *row = current + i*nb_cols;
+        real *new_row = next + i*nb_cols;
+        __m256d error_low  = _mm256_setzero_pd();
+        __m256d error_high = _mm256_setzero_pd();
+        int j = first_col;
+
+        for (; j+7 <= last_col; j += 8)
+        {
+            __m256 top    = _mm256_loadu_ps(row+j-nb_cols);
+            __m256 bottom = _mm256_loadu_ps(row+j+nb_cols);
+            __m256 left   = _mm256_loadu_ps(row+j-1);
+            __m256 right  = _mm256_loadu_ps(row+j+1);
+            __m256 old    = _mm256_loadu_ps(row+j);
+
+            __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(bottom, top), left), right);
+            __m256 new_value = _mm256_mul_ps(quarter, sum);
+            _mm256_storeu_ps(new_row+j, new_value);
+
+            if (with_error)
+            {
+                __m256 diff = _mm256_sub_ps(new_value, old);
+                __m256 diff2 = _mm256_mul_ps(diff, diff);
+                error_low  = _mm256_add_pd(error_low,  _mm256_cvtps_pd(_mm256_castps256_ps128(diff2)));
+                error_high = _mm256_add_pd(error_high, _mm256_cvtps_pd(_mm256_extractf128_ps(diff2, 1)));
+            }
+        }
+
+        double partial[4];
+        _mm256_storeu_pd(partial, _mm256_add_pd(error_low, error_high));
+        local_error_sum += (partial[0] + partial[1]) + (partial[2] + partial[3]);
+        local_error_sum += sweep_scalar_row(current, next, i, j, last_col, nb_cols, with_error);
+    }
+    return local_error_sum;
+}
+
+
+/**
+ * AVX-512 version : 16 values per iteration, the squared differences are converted to double and summed in 2 vectors of 8 doubles
+ */
+__attribute__((target("avx512f")))
+static double sweep_avx512(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols, int with_error)
+{
+    double local_error_sum = 0;
+    const __m512 quarter = _mm512_set1_ps(0.25f);
+
+    for (int i = first_row; i <= last_row; i++)
+    {
+        const real *row = current + i*nb_cols;
+        real *new_row = next + i*nb_cols;
+        __m512d error_low  = _mm512_setzero_pd();
+        __m512d error_high = _mm512_setzero_pd();
+        int j = first_col;
+
+        for (; j+15 <= last_col; j += 16)
+        {
+            __m512 top    = _mm512_loadu_ps(row+j-nb_cols);
+            __m512 bottom = _mm512_loadu_ps(row+j+nb_cols);
+            __m512 left   = _mm512_loadu_ps(row+j-1);
+            __m512 right  = _mm512_loadu_ps(row+j+1);
+            __m512 old    = _mm512_loadu_ps(row+j);
+
+            __m512 sum = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(bottom, top), left), right);
+            __m512 new_value = _mm512_mul_ps(quarter, sum);
+            _mm512_storeu_ps(new_row+j, new_value);
+
+            if (with_error)
+            {
+                __m512 diff = _mm512_sub_ps(new_value, old);
+                __m512 diff2 = _mm512_mul_ps(diff, diff);
+                error_low  = _mm512_add_pd(error_low,  _mm512_cvtps_pd(_mm512_castps512_ps256(diff2)));
+                error_high = _mm512_add_pd(error_high, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(diff2), 1))));
+            }
+        }
+
+        local_error_sum += _mm512_reduce_add_pd(_mm512_add_pd(error_low, error_high));
+        local_error_sum += sweep_scalar_row(current, next, i, j, last_col, nb_cols, with_error);
+    }
+    return local_error_sum;
+}
+
+#endif
+
+
+#if defined(STENCIL_X86) && defined(STENCIL_DOUBLE_CALC)
+
+// Vectors of doubles loaded from and stored to the values : double values, or float values converted (double-calc)
+#ifdef LAPLACE_DOUBLE
+#define LOAD_PD256(address)         _mm256_loadu_pd(address)
+#define STORE_PD256(address, value) _mm256_storeu_pd(address, value)
+#define LOAD_PD512(address)         _mm512_loadu_pd(address)
+#define STORE_PD512(address, value) _mm512_storeu_pd(address, value)
+#else
+#define LOAD_PD256(address)         _mm256_cvtps_pd(_mm_loadu_ps(address))
+#define STORE_PD256(address, value) _mm_storeu_ps(address, _mm256_cvtpd_ps(value))
+#define LOAD_PD512(address)         _mm512_cvtps_pd(_mm256_loadu_ps(address))
+#define STORE_PD512(address, value) _mm256_storeu_ps(address, _mm512_cvtpd_ps(value))
+#endif
+
+
+/**
+ * AVX2 version in double precision : 4 values per iteration
+ */
+__attribute__((target("avx2")))
+static double sweep_avx2(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols, int with_error)
+{
+    double local_error_sum = 0;
+    const __m256d quarter = _mm256_set1_pd(0.25);
+
+    for (int i = first_row; i <= last_row; i++)
+    {
+        const real *row = current + i*nb_cols;
+        real *new_row = next + i*nb_cols;
+        __m256d error = _mm256_setzero_pd();
+        int j = first_col;
+
+        for (; j+3 <= last_col; j += 4)
+        {
+            __m256d top    = LOAD_PD256(row+j-nb_cols);
+            __m256d bottom = LOAD_PD256(row+j+nb_cols);
+            __m256d left   = LOAD_PD256(row+j-1);
+            __m256d right  = LOAD_PD256(row+j+1);
+            __m256d old    = LOAD_PD256(row+j);
+
+            __m256d sum = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(bottom, top), left), right);
+            __m256d new_value = _mm256_mul_pd(quarter, sum);
+            STORE_PD256(new_row+j, new_value);
+
+            if (with_error)
+            {
+                __m256d diff = _mm256_sub_pd(new_value, old);
+                error = _mm256_add_pd(error, _mm256_mul_pd(diff, diff));
+            }
+        }
+
+        double partial[4];
+        _mm256_storeu_pd(partial, error);
+        local_error_sum += (partial[0] + partial[1]) + (partial[2] + partial[3]);
+        local_error_sum += sweep_scalar_row(current, next, i, j, last_col, nb_cols, with_error);
+    }
+    return local_error_sum;
+}
+
+
+/**
+ * AVX-512 version in double precision : 8 values per iteration
+ */
+__attribute__((target("avx512f")))
+static double sweep_avx512(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols, int with_error)
+{
+    double local_error_sum = 0;
+    const __m512d quarter = _mm512_set1_pd(0.25);
+
+    for (int i = first_row; i <= last_row; i++)
+    {
+        const real *row = current + i*nb_cols;
+        real *new_row = next + i*nb_cols;
+        __m512d error = _mm512_setzero_pd();
+        int j = first_col;
+
+        for (; j+7 <= last_col; j += 8)
+        {
+            __m512d top    = LOAD_PD512(row+j-nb_cols);
+            __m512d bottom = LOAD_PD512(row+j+nb_cols);
+            __m512d left   = LOAD_PD512(row+j-1);
+            __m512d right  = LOAD_PD512(row+j+1);
+            __m512d old    = LOAD_PD512(row+j);
+
+            __m512d sum = _mm512_add_pd(_mm512_add_pd(_mm512_add_pd(bottom, top), left), right);
+            __m512d new_value = _mm512_mul_pd(quarter, sum);
+            STORE_PD512(new_row+j, new_value);
+
+            if (with_error)
+            {
+                __m512d diff = _mm512_sub_pd(new_value, old);
+                error = _mm512_add_pd(error, _mm512_mul_pd(diff, diff));
+            }
+        }
+
+        local_error_sum += _mm512_reduce_add_pd(error);
+        local_error_sum += sweep_scalar_row(current, next, i, j, last_col, nb_cols, with_error);
+    }
+    return local_error_sum;
+}
+
+#endif
+
+
+static sweep_function selected_sweep = NULL;
+static const char *selected_name = "scalar";
+static int selected_tile_cols = 0; // 0 : whole rows
+
+
+/**
+ * Choose the kernel the first time it is used : the best one supported by the processor, unless LAPLACE_KERNEL forces it
+ */
+static void select_kernel(void)
+{
+    const char *forced = getenv("LAPLACE_KERNEL");
+    selected_sweep = sweep_scalar;
+    selected_name = "scalar";
+
+#ifdef STENCIL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && (forced == NULL || strcmp(forced, "avx512") == 0))
+    {
+        selected_sweep = sweep_avx512;
+        selected_name = "avx512";
+    }
+    else if (__builtin_cpu_supports("avx2") && (forced == NULL || strcmp(forced, "avx512") == 0 || strcmp(forced, "avx2") == 0))
+    {
+        selected_sweep = sweep_avx2;
+        selected_name = "avx2";
+    }
+#endif
+}
+
+
+double stencil_sweep(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols, int with_error)
+{
+    if (selected_sweep == NULL) { select_kernel(); }
+    if (first_row > last_row || first_col > last_col) { return 0; }
+
+    // Hybrid mode : the rows are shared between the OpenMP threads, each thread sums its own errors (reduction).
+    // The small blocks (edges of the local matrix) stay on one thread, the cost of the parallel region would be higher.
+    // With strips, each thread computes the same rows in every strip (static schedule).
+    int strip = (selected_tile_cols > 0) ? selected_tile_cols : last_col-first_col+1;
+    double local_error_sum = 0;
+    #pragma omp parallel reduction(+:local_error_sum) if((long)(last_row-first_row+1)*(last_col-first_col+1) >= STENCIL_MIN_PARALLEL_CELLS)
+    for (int strip_first = first_col; strip_first <= last_col; strip_first += strip)
+    {
+        int strip_last = (strip_first+strip-1 < last_col) ? strip_first+strip-1 : last_col;
+        #pragma omp for schedule(static)
+        for (int i = first_row; i <= last_row; i++)
+        {
+            local_error_sum += selected_sweep(current, next, i, i, strip_first, strip_last, nb_cols, with_error);
+        }
+    }
+    return local_error_sum;
+}
+
+
+double stencil_wavefront(real *tab0, real *tab1, int nb_steps, const stencil_region regions[], int nb_cols, int with_error)
+{
+    if (selected_sweep == NULL) { select_kernel(); }
+    real *tabs[2] = {tab0, tab1};
+    int first_wave = regions[0].first_row, last_wave = regions[0].last_row;
+    for (int step = 1; step < nb_steps; step++) // the row i of the iteration step is computed by the wave i + 2*step
+    {
+        if (regions[step].first_row + 2*step < first_wave) { first_wave = regions[step].first_row + 2*step; }
+        if (regions[step].last_row + 2*step > last_wave)   { last_wave = regions[step].last_row + 2*step; }
+    }
+
+    double local_error_sum = 0;
+    for (int wave = first_wave; wave <= last_wave; wave++)
+    {
+        for (int step = 0; step < nb_steps; step++)
+        {
+            const stencil_region *region = &regions[step];
+            int i = wave - 2*step;
+            if (i < region->first_row || i > region->last_row) { continue; }
+
+            const real *current = tabs[step%2];
+            real *next = tabs[(step+1)%2];
+            int row_error = with_error && step == nb_steps-1;
+            local_error_sum += selected_sweep(current, next, i, i, region->first_col, region->last_col, nb_cols, row_error);
+        }
+    }
+    return local_error_sum;
+}
+
+
+/**
+ * Time in seconds (monotonic clock), for the tuning of the strips
+ */
+static double wall_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + 1e-9*now.tv_nsec;
+}
+
+
+void stencil_set_tile_cols(int tile_cols)
+{
+    selected_tile_cols = tile_cols;
+}
+
+
+int stencil_tune_tile_cols(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols)
+{
+    int best_tile_cols = 0;
+    double best_time = -1;
+    for (int tile_cols = 0; tile_cols == 0 || tile_cols < last_col-first_col+1; tile_cols = (tile_cols == 0) ? STENCIL_MIN_TILE_COLS : 2*tile_cols)
+    {
+        stencil_set_tile_cols(tile_cols);
+        stencil_sweep(current, next, first_row, last_row, first_col, last_col, nb_cols, 1); // warm up
+        double start = wall_time();
+        for (int sweep = 0; sweep < STENCIL_TUNING_SWEEPS; sweep++)
+        {
+            stencil_sweep(current, next, first_row, last_row, first_col, last_col, nb_cols, 1);
+        }
+        double time = wall_time() - start;
+        if (best_time < 0 || time < best_time)
+        {
+            best_time = time;
+            best_tile_cols = tile_cols;
+        }
+    }
+    stencil_set_tile_cols(best_tile_cols);
+    return best_tile_cols;
+}
+
+
+/**
+ * New value of a cell of the red-black half-sweep (omega = 1 : the Gauss-Seidel value itself, without rounding)
+ */
+static inline real_calc relax_value(real_calc value, real_calc bottom_neighbor, real_calc top_neighbor, real_calc left_neighbor, real_calc right_neighbor, real_calc source, real omega)
+{
+    real_calc gauss_seidel = (real_calc)0.25*(bottom_neighbor + top_neighbor + left_neighbor + right_neighbor + source); // + 0 does not change the sum
+    return (omega == 1) ? gauss_seidel : value + omega*(gauss_seidel - value);
+}
+
+
+double stencil_relax_color(real *tab, const real *rhs, int first_row, int last_row, int first_col, int last_col, int nb_cols, int parity, real omega, int with_error)
+{
+    if (first_row > last_row || first_col > last_col) { return 0; }
+
+    double local_error_sum = 0;
+    #pragma omp parallel for schedule(static) reduction(+:local_error_sum) if((long)(last_row-first_row+1)*(last_col-first_col+1) >= 2*STENCIL_MIN_PARALLEL_CELLS)
+    for (int i = first_row; i <= last_row; i++)
+    {
+        for (int j = first_col + ((i+first_col+parity) & 1); j <= last_col; j += 2) // first column of the colour on this row
+        {
+            real_calc value = tab[j+i*nb_cols];
+            real_calc source = (rhs != NULL) ? rhs[j+i*nb_cols] : 0;
+            real_calc new_value = relax_value(value, tab[j+(i+1)*nb_cols], tab[j+(i-1)*nb_cols], tab[(j-1)+i*nb_cols], tab[(j+1)+i*nb_cols], source, omega);
+            real_calc diff = new_value - value;
+
+            tab[j+i*nb_cols] = new_value;
+            if (with_error) { local_error_sum += diff*diff; }
+        }
+    }
+    return local_error_sum;
+}
+
+
+void stencil_sweep_batch(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols,
+                         int nb_problems, int with_error, double *errors)
+{
+    if (first_row > last_row || first_col > last_col) { return; }
+
+    long row = (long)nb_cols*nb_problems; // distance between the values of a cell and of its top (bottom) neighbor
+    #pragma omp parallel for schedule(static) reduction(+:errors[:nb_problems]) if((long)(last_row-first_row+1)*(last_col-first_col+1)*nb_problems >= STENCIL_MIN_PARALLEL_CELLS)
+    for (int i = first_row; i <= last_row; i++)
+    {
+        for (int j = first_col; j <= last_col; j++)
+        {
+            const real *cell = current + (j + (long)i*nb_cols)*nb_problems;
+            real *new_cell = next + (j + (long)i*nb_cols)*nb_problems;
+            for (int b = 0; b < nb_problems; b++) // contiguous : vectorized by the compiler
+            {
+                real_calc new_value = (real_calc)0.25*((real_calc)cell[b+row] + cell[b-row] + cell[b-nb_problems] + cell[b+nb_problems]); // as sweep_scalar_row
+                real_calc diff = new_value - cell[b];
+
+                new_cell[b] = new_value;
+                if (with_error) { errors[b] += diff*diff; }
+            }
+        }
+    }
+}
+
+
+void stencil_relax_color_batch(real *tab, int first_row, int last_row, int first_col, int last_col, int nb_cols,
+                               int nb_problems, int parity, real omega, int with_error, double *errors)
+{
+    if (first_row > last_row || first_col > last_col) { return; }
+
+    long row = (long)nb_cols*nb_problems;
+    #pragma omp parallel for schedule(static) reduction(+:errors[:nb_problems]) if((long)(last_row-first_row+1)*(last_col-first_col+1)*nb_problems >= 2*STENCIL_MIN_PARALLEL_CELLS)
+    for (int i = first_row; i <= last_row; i++)
+    {
+        for (int j = first_col + ((i+first_col+parity) & 1); j <= last_col; j += 2) // first column of the colour on this row
+        {
+            real *cell = tab + (j + (long)i*nb_cols)*nb_problems;
+            for (int b = 0; b < nb_problems; b++)
+            {
+                real_calc value = cell[b];
+                real_calc new_value = relax_value(value, cell[b+row], cell[b-row], cell[b-nb_problems], cell[b+nb_problems], 0, omega);
+                real_calc diff = new_value - value;
+
+                cell[b] = new_value;
+                if (with_error) { errors[b] += diff*diff; }
+            }
+        }
+    }
+}
+
+
+double stencil_laplacian(const real *tab, real *result, int first_row, int last_row, int first_col, int last_col, int nb_cols)
+{
+    if (first_row > last_row || first_col > last_col) { return 0; }
+
+    double product = 0;
+    #pragma omp parallel for schedule(static) reduction(+:product) if((long)(last_row-first_row+1)*(last_col-first_col+1) >= STENCIL_MIN_PARALLEL_CELLS)
+    for (int i = first_row; i <= last_row; i++)
+    {
+        for (int j = first_col; j <= last_col; j++)
+        {
+            real_calc value = tab[j+i*nb_cols];
+            real_calc neighbors = tab[j+(i+1)*nb_cols] + tab[j+(i-1)*nb_cols] + tab[(j-1)+i*nb_cols] + tab[(j+1)+i*nb_cols];
+            real_calc new_value = (real_calc)4*value - neighbors;
+
+            result[j+i*nb_cols] = new_value;
+            product += (double)value*new_value;
+        }
+    }
+    return product;
+}
+
+
+double stencil_sweep_3d(const real *current, real *next, int first_plane, int last_plane, int first_row, int last_row,
+                        int first_col, int last_col, int nb_rows, int nb_cols, int with_error)
+{
+    if (first_plane > last_plane || first_row > last_row || first_col > last_col) { return 0; }
+
+    long plane = (long)nb_rows*nb_cols;
+    const real_calc one_sixth = (real_calc)1/6;
+    double local_error_sum = 0;
+    #pragma omp parallel for collapse(2) schedule(static) reduction(+:local_error_sum) if((long)(last_plane-first_plane+1)*(last_row-first_row+1)*(last_col-first_col+1) >= STENCIL_MIN_PARALLEL_CELLS)
+    for (int k = first_plane; k <= last_plane; k++)
+    {
+        for (int i = first_row; i <= last_row; i++)
+        {
+            const real *c = current + k*plane + (long)i*nb_cols;
+            real *n = next + k*plane + (long)i*nb_cols;
+            if (!with_error) // no reduction : the compiler can vectorize the row
+            {
+                for (int j = first_col; j <= last_col; j++)
+                {
+                    n[j] = one_sixth*((real_calc)c[j+nb_cols] + c[j-nb_cols] + c[j-1] + c[j+1] + c[j-plane] + c[j+plane]);
+                }
+                continue;
+            }
+            for (int j = first_col; j <= last_col; j++)
+            {
+                real_calc new_value = one_sixth*((real_calc)c[j+nb_cols] + c[j-nb_cols] + c[j-1] + c[j+1] + c[j-plane] + c[j+plane]);
+                real_calc diff = new_value - c[j];
+                n[j] = new_value;
+                local_error_sum += diff*diff;
+            }
+        }
+    }
+    return local_error_sum;
+}
+
+
+double stencil_relax_color_3d(real *tab, int first_plane, int last_plane, int first_row, int last_row, int first_col, int last_col,
+                              int nb_rows, int nb_cols, int parity, real omega, int with_error)
+{
+    if (first_plane > last_plane || first_row > last_row || first_col > last_col) { return 0; }
+
+    long plane = (long)nb_rows*nb_cols;
+    const real_calc one_sixth = (real_calc)1/6;
+    double local_error_sum = 0;
+    #pragma omp parallel for collapse(2) schedule(static) reduction(+:local_error_sum) if((long)(last_plane-first_plane+1)*(last_row-first_row+1)*(last_col-first_col+1) >= 2*STENCIL_MIN_PARALLEL_CELLS)
+    for (int k = first_plane; k <= last_plane; k++)
+    {
+        for (int i = first_row; i <= last_row; i++)
+        {
+            real *t = tab + k*plane + (long)i*nb_cols;
+            for (int j = first_col + ((k+i+first_col+parity) & 1); j <= last_col; j += 2) // first column of the colour on this row
+            {
+                real_calc value = t[j];
+                real_calc gauss_seidel = one_sixth*((real_calc)t[j+nb_cols] + t[j-nb_cols] + t[j-1] + t[j+1] + t[j-plane] + t[j+plane]);
+                real_calc new_value = (omega == 1) ? gauss_seidel : value + omega*(gauss_seidel - value);
+                real_calc diff = new_value - value;
+
+                t[j] = new_value;
+                if (with_error) { local_error_sum += diff*diff; }
+            }
+        }
+    }
+    return local_error_sum;
+}
+
+
+const char *stencil_kernel_name(void)
+{
+    if (selected_sweep == NULL) { select_kernel(); }
+    return selected_name;
+}
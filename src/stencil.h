@@ -0,0 +1,123 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Jacobi and red-black (Gauss-Seidel, SOR) stencil kernels and the laplacian operator (conjugate gradient), shared by all the decompositions
+
+The kernel is chosen at runtime according to the processor : AVX-512, AVX2 or scalar.
+The choice can be forced with the environment variable LAPLACE_KERNEL=avx512|avx2|scalar.
+The values are real (float or double) and the updates are computed in real_calc, see precision.h.
+
+----------------------------------------------------------------------
+*/
+
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include "precision.h"
+
+
+#define STENCIL_MIN_PARALLEL_CELLS 16384 // smaller blocks are computed by a single thread (alloc_matrix touches the pages the same way)
+
+/**
+ * Compute the new values of the block [first_row..last_row] x [first_col..last_col] (included) of a matrix of nb_cols columns :
+ * next = 0.25 * (bottom + top + left + right neighbors in current).
+ * All the neighbors of the block are read in current, so they must be valid (adjacent values included).
+ * In hybrid mode (compiled with OpenMP), the rows are computed by the OpenMP threads : it must be called by one thread only.
+ * Returns the sum of the squared differences between the new and the previous values (0 if with_error is 0 : not computed).
+ */
+double stencil_sweep(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols, int with_error);
+
+
+/**
+ * Red-black half-sweep, in place : the cells (i,j) of the block such that (i+j)%2 == parity take the value
+ * tab + omega * (0.25 * (bottom + top + left + right neighbors + rhs) - tab) (omega = 1 : Gauss-Seidel, 1 < omega < 2 : SOR).
+ * rhs is the right-hand side of 4*tab - neighbors = rhs, in a matrix of the same dimensions as tab (NULL : 0, the laplace equation).
+ * Their neighbors have the other colour, so the order of the updates does not change the result.
+ * As for stencil_sweep, all the neighbors of the block must be valid, and it must be called by one thread only.
+ * Returns the sum of the squared differences between the new and the previous values (0 if with_error is 0).
+ */
+double stencil_relax_color(real *tab, const real *rhs, int first_row, int last_row, int first_col, int last_col, int nb_cols, int parity, real omega, int with_error);
+
+
+/**
+ * Batches (batch.h) : nb_problems local matrices stored interleaved, the nb_problems values of the cell (i,j) are contiguous
+ * (value of the problem b at (j+i*nb_cols)*nb_problems + b), so the innermost loop updates the same cell of all the problems.
+ * stencil_sweep and stencil_relax_color (without right-hand side) on all the problems at once : the new values are the same
+ * as for each problem alone, and the squared differences of the problem b are added to errors[b] (if with_error is not 0).
+ */
+void stencil_sweep_batch(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols,
+                         int nb_problems, int with_error, double *errors);
+void stencil_relax_color_batch(real *tab, int first_row, int last_row, int first_col, int last_col, int nb_cols,
+                               int nb_problems, int parity, real omega, int with_error, double *errors);
+
+
+/**
+ * Region of a matrix computed by one iteration of stencil_wavefront (rows and columns included)
+ */
+typedef struct
+{
+    int first_row, last_row;
+    int first_col, last_col;
+} stencil_region;
+
+
+/**
+ * Temporal blocking (wavefront) : nb_steps Jacobi iterations at once, on the buffers tab0 (values of the first iteration) and tab1,
+ * which swap their roles at each iteration : the iteration s (0-based) computes regions[s] from tab0 (s even) or tab1 (s odd).
+ * Each region must be inside the previous one shrunk by a cell (or stop on the same adjacent values).
+ * The rows are computed by a wavefront : the iteration s computes its row i right after the iteration s-1 has computed its row i+2,
+ * so the rows are reused while they are in cache, and a buffer row is only overwritten once its previous values are not needed.
+ * The final values are in tab0 if nb_steps is even, tab1 if it is odd.
+ * Returns the sum of the squared differences of the last iteration (0 if with_error is 0). It is computed by the calling thread.
+ */
+double stencil_wavefront(real *tab0, real *tab1, int nb_steps, const stencil_region regions[], int nb_cols, int with_error);
+
+
+/**
+ * Spatial blocking of stencil_sweep : the columns of a block are computed in strips of tile_cols columns
+ * (0 : whole rows), so that the 3 rows read by a strip stay in cache when the rows are long
+ */
+void stencil_set_tile_cols(int tile_cols);
+
+
+/**
+ * Choose the width of the strips of stencil_sweep by timing a few sweeps of the block (next is overwritten),
+ * among whole rows and widths from 64 columns : returns the fastest one, which is set for the next sweeps
+ */
+int stencil_tune_tile_cols(const real *current, real *next, int first_row, int last_row, int first_col, int last_col, int nb_cols);
+
+
+/**
+ * Laplacian operator of the block, for the conjugate gradient : result = 4*tab - (bottom + top + left + right neighbors in tab).
+ * As for stencil_sweep, all the neighbors of the block must be valid, and it must be called by one thread only.
+ * Returns the scalar product of tab and result on the block (sum of tab*result).
+ */
+double stencil_laplacian(const real *tab, real *result, int first_row, int last_row, int first_col, int last_col, int nb_cols);
+
+
+/**
+ * 3D Jacobi iteration (7-point stencil) on the box [first_plane..last_plane] x [first_row..last_row] x [first_col..last_col] (included)
+ * of a matrix of nb_rows x nb_cols values per plane : next = (bottom + top + left + right + front + back neighbors in current) / 6.
+ * As for stencil_sweep, all the neighbors of the box must be valid, and it must be called by one thread only.
+ * Returns the sum of the squared differences between the new and the previous values (0 if with_error is 0).
+ */
+double stencil_sweep_3d(const real *current, real *next, int first_plane, int last_plane, int first_row, int last_row,
+                        int first_col, int last_col, int nb_rows, int nb_cols, int with_error);
+
+
+/**
+ * 3D red-black half-sweep, in place : the cells (k,i,j) of the box such that (k+i+j)%2 == parity take the value
+ * tab + omega * ((sum of the 6 neighbors) / 6 - tab), as stencil_relax_color in 2D.
+ */
+double stencil_relax_color_3d(real *tab, int first_plane, int last_plane, int first_row, int last_row, int first_col, int last_col,
+                              int nb_rows, int nb_cols, int parity, real omega, int with_error);
+
+
+/**
+ * Name of the kernel used by stencil_sweep ("avx512", "avx2" or "scalar")
+ */
+const char *stencil_kernel_name(void);
+
+
+#endif
@@ -0,0 +1,56 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Time spent by the solvers in each phase of the iterations
+
+----------------------------------------------------------------------
+*/
+
+
+#include "mpi.h"
+#include "timers.h"
+
+
+#ifndef LAPLACE_NO_TIMERS
+
+static double phase_times[NB_TIMERS];       // time charged to each phase
+static timer_phase current_phase = TIMER_OTHER;
+static double phase_start = 0;              // MPI_Wtime() of the last switch
+
+
+void timers_reset(void)
+{
+    for (int phase = 0; phase < NB_TIMERS; phase++)
+    {
+        phase_times[phase] = 0;
+    }
+    current_phase = TIMER_OTHER;
+    phase_start = MPI_Wtime();
+}
+
+
+timer_phase timer_switch(timer_phase phase)
+{
+    double now = MPI_Wtime();
+    timer_phase previous = current_phase;
+    phase_times[current_phase] += now - phase_start;
+    current_phase = phase;
+    phase_start = now;
+    return previous;
+}
+
+
+double timer_get(timer_phase phase)
+{
+    return phase_times[phase];
+}
+
+#endif
+
+
+const char *timer_name(timer_phase phase)
+{
+    static const char *names[NB_TIMERS] = {"compute", "copy", "halo_start", "halo_wait", "reduction", "other"};
+    return names[phase];
+}
@@ -0,0 +1,73 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Time spent by the solvers in each phase of the iterations, shared by all the programs
+
+The time is charged to one phase at a time : timer_switch closes the current phase (one MPI_Wtime call)
+and opens the next one. The exchanges of the adjacent data (grid.c) switch to TIMER_HALO_START or TIMER_HALO_WAIT and back
+by themselves, the solvers switch to TIMER_REDUCTION around the reductions of the error, to TIMER_COPY around the copies
+of their buffers and to TIMER_OTHER around the checkpoints. The phases are aggregated over the processors by bench.c.
+
+-DLAPLACE_NO_TIMERS removes the timers at compile time : the functions below become empty inline functions,
+and all the phases are reported as 0 (TIMERS_ENABLED is 0).
+
+----------------------------------------------------------------------
+*/
+
+#ifndef TIMERS_H
+#define TIMERS_H
+
+
+/**
+ * Phases of the iterations
+ */
+typedef enum
+{
+    TIMER_COMPUTE,      // stencil sweeps and the other local computations
+    TIMER_COPY,         // copies between the buffers of the solvers and of the checkpoints (the Jacobi buffers are swapped, not copied)
+    TIMER_HALO_START,   // start of the exchanges of the adjacent data (messages posted)
+    TIMER_HALO_WAIT,    // wait for the end of the exchanges, gathers of the coarse multigrid levels
+    TIMER_REDUCTION,    // reductions of the error and of the scalar products (and the wait of an asynchronous one)
+    TIMER_OTHER,        // checkpoints, initialization of the solver, outside the iterations
+    NB_TIMERS
+} timer_phase;
+
+
+#ifndef LAPLACE_NO_TIMERS
+
+#define TIMERS_ENABLED 1
+
+/**
+ * Set all the times to 0 and open the phase TIMER_OTHER
+ */
+void timers_reset(void);
+
+/**
+ * Charge the time since the last switch to the current phase, and open the phase phase.
+ * Returns the previous phase, so that a function can switch back to the phase of its caller.
+ */
+timer_phase timer_switch(timer_phase phase);
+
+/**
+ * Time charged to a phase (seconds) until the last switch
+ */
+double timer_get(timer_phase phase);
+
+#else
+
+#define TIMERS_ENABLED 0
+
+static inline void timers_reset(void) {}
+static inline timer_phase timer_switch(timer_phase phase) { (void)phase; return TIMER_OTHER; }
+static inline double timer_get(timer_phase phase) { (void)phase; return 0; }
+
+#endif
+
+/**
+ * Name of a phase in the reports : "compute", "copy", "halo_start", "halo_wait", "reduction", "other"
+ */
+const char *timer_name(timer_phase phase);
+
+
+#endif
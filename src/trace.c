@@ -0,0 +1,315 @@
+/*
+----------------------------------------------------------------------
+
+Parallel implementation of Laplace equation
+Trace of the MPI calls through the profiling interface (PMPI), optional for all the programs
+
+Adding trace.c to the compile line intercepts the MPI calls of the solvers : the exchanges of the adjacent data,
+their waits, the reductions and the collectives of the programs. Each processor counts its calls, their time
+and the bytes given to them, and at MPI_Finalize all the processors write their records in a single CSV file :
+    rank,record,call,calls,start,time,max_time,bytes,peer
+A "summary" line per processor and per call (start and peer empty), and with LAPLACE_TRACE_EVENTS=n the first n
+calls of each processor as "event" lines (start : seconds since MPI_Init, peer : destination, source or root, -1 otherwise).
+The file is laplace_trace.csv, or the value of LAPLACE_TRACE. Without trace.c, nothing is traced and nothing is changed.
+
+----------------------------------------------------------------------
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpi.h"
+
+
+/**
+ * Traced calls
+ */
+typedef enum
+{
+    TRACE_ISEND,
+    TRACE_IRECV,
+    TRACE_RECV,
+    TRACE_WAIT,
+    TRACE_WAITALL,
+    TRACE_NEIGHBOR_ALLTOALLW,
+    TRACE_ALLREDUCE,
+    TRACE_IALLREDUCE,
+    TRACE_REDUCE,
+    TRACE_BCAST,
+    TRACE_BARRIER,
+    NB_TRACE_CALLS
+} trace_call;
+
+static const char *trace_names[NB_TRACE_CALLS] = {"MPI_Isend", "MPI_Irecv", "MPI_Recv", "MPI_Wait", "MPI_Waitall",
+    "MPI_Ineighbor_alltoallw", "MPI_Allreduce", "MPI_Iallreduce", "MPI_Reduce", "MPI_Bcast", "MPI_Barrier"};
+
+
+/**
+ * Summary of a call on this processor
+ */
+typedef struct
+{
+    long calls;
+    double time, max_time;  // seconds : total and longest call
+    long long bytes;        // bytes sent (or received by MPI_Irecv and MPI_Recv)
+} trace_summary;
+
+
+/**
+ * A call of the event log
+ */
+typedef struct
+{
+    trace_call call;
+    double start, time;     // seconds since MPI_Init, duration
+    long long bytes;
+    int peer;
+} trace_event;
+
+
+static trace_summary summaries[NB_TRACE_CALLS];
+static trace_event *events = NULL;  // first max_events calls
+static long max_events = 0, nb_events = 0;
+static double trace_origin = 0;     // time of MPI_Init
+
+
+/**
+ * Bytes of count elements of datatype
+ */
+static long long trace_bytes(int count, MPI_Datatype datatype)
+{
+    int size = 0;
+    if (datatype != MPI_DATATYPE_NULL) { PMPI_Type_size(datatype, &size); }
+    return (long long)count*size;
+}
+
+
+/**
+ * Record a call which started at start (MPI_Wtime)
+ */
+static void trace_record(trace_call call, double start, long long bytes, int peer)
+{
+    double time = PMPI_Wtime() - start;
+    trace_summary *summary = &summaries[call];
+    summary->calls++;
+    summary->time += time;
+    if (time > summary->max_time) { summary->max_time = time; }
+    summary->bytes += bytes;
+    if (nb_events < max_events)
+    {
+        trace_event event = { call, start - trace_origin, time, bytes, peer };
+        events[nb_events++] = event;
+    }
+}
+
+
+/**
+ * Read the settings of the trace, after the initialization of MPI
+ */
+static void trace_init(void)
+{
+    trace_origin = PMPI_Wtime();
+    const char *value = getenv("LAPLACE_TRACE_EVENTS");
+    max_events = (value != NULL) ? atol(value) : 0;
+    if (max_events > 0 && (events = (trace_event*)malloc(max_events*sizeof(trace_event))) == NULL)
+    {
+        max_events = 0; // summary only
+    }
+}
+
+
+/**
+ * Write the records of all the processors in the trace file (collective on MPI_COMM_WORLD) :
+ * each processor formats its lines, and writes them at its offset in the file
+ */
+static void trace_write(void)
+{
+    int me;
+    PMPI_Comm_rank(MPI_COMM_WORLD, &me);
+    const char *filename = getenv("LAPLACE_TRACE");
+    if (filename == NULL || filename[0] == '\0') { filename = "laplace_trace.csv"; }
+
+    size_t capacity = 128 + 256*(NB_TRACE_CALLS + nb_events), length = 0;
+    char *text = (char*)malloc(capacity);
+    if (text == NULL) { exit(-1); } // Check if the memory has been well allocated
+    if (me == 0)
+    {
+        length += snprintf(text + length, capacity - length, "rank,record,call,calls,start,time,max_time,bytes,peer\n");
+    }
+    for (int call = 0; call < NB_TRACE_CALLS; call++)
+    {
+        const trace_summary *summary = &summaries[call];
+        if (summary->calls == 0) { continue; }
+        length += snprintf(text + length, capacity - length, "%d,summary,%s,%ld,,%.9g,%.9g,%lld,\n",
+                           me, trace_names[call], summary->calls, summary->time, summary->max_time, summary->bytes);
+    }
+    for (long e = 0; e < nb_events; e++)
+    {
+        const trace_event *event = &events[e];
+        length += snprintf(text + length, capacity - length, "%d,event,%s,1,%.9f,%.9g,%.9g,%lld,%d\n",
+                           me, trace_names[event->call], event->start, event->time, event->time, event->bytes, event->peer);
+    }
+
+    long long my_length = length, offset = 0;
+    PMPI_Exscan(&my_length, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (me == 0) { offset = 0; } // undefined on the processor 0
+
+    MPI_File file;
+    if (PMPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+    {
+        if (me == 0) { fprintf(stderr, "trace: cannot open %s\n", filename); }
+    }
+    else
+    {
+        PMPI_File_set_size(file, 0); // no line of a previous trace
+        PMPI_File_write_at_all(file, offset, text, (int)length, MPI_CHAR, MPI_STATUS_IGNORE);
+        PMPI_File_close(&file);
+    }
+    free(text);
+    free(events);
+    events = NULL;
+    nb_events = max_events = 0;
+}
+
+
+int MPI_Init(int *argc, char ***argv)
+{
+    int result = PMPI_Init(argc, argv);
+    trace_init();
+    return result;
+}
+
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided)
+{
+    int result = PMPI_Init_thread(argc, argv, required, provided);
+    trace_init();
+    return result;
+}
+
+
+int MPI_Finalize(void)
+{
+    trace_write();
+    return PMPI_Finalize();
+}
+
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm, MPI_Request *request)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
+    trace_record(TRACE_ISEND, start, trace_bytes(count, datatype), dest);
+    return result;
+}
+
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Request *request)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Irecv(buf, count, datatype, source, tag, comm, request);
+    trace_record(TRACE_IRECV, start, trace_bytes(count, datatype), source);
+    return result;
+}
+
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Recv(buf, count, datatype, source, tag, comm, status);
+    trace_record(TRACE_RECV, start, trace_bytes(count, datatype), source);
+    return result;
+}
+
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Wait(request, status);
+    trace_record(TRACE_WAIT, start, 0, -1);
+    return result;
+}
+
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status *array_of_statuses)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Waitall(count, array_of_requests, array_of_statuses);
+    trace_record(TRACE_WAITALL, start, 0, -1);
+    return result;
+}
+
+
+int MPI_Ineighbor_alltoallw(const void *sendbuf, const int sendcounts[], const MPI_Aint sdispls[], const MPI_Datatype sendtypes[],
+                            void *recvbuf, const int recvcounts[], const MPI_Aint rdispls[], const MPI_Datatype recvtypes[],
+                            MPI_Comm comm, MPI_Request *request)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Ineighbor_alltoallw(sendbuf, sendcounts, sdispls, sendtypes, recvbuf, recvcounts, rdispls, recvtypes, comm, request);
+
+    int topology, nb_neighbors = 0; // Cartesian communicator (2 neighbors per dimension) or distributed graph
+    PMPI_Topo_test(comm, &topology);
+    if (topology == MPI_CART)
+    {
+        PMPI_Cartdim_get(comm, &nb_neighbors);
+        nb_neighbors *= 2;
+    }
+    else if (topology == MPI_DIST_GRAPH)
+    {
+        int indegree, weighted;
+        PMPI_Dist_graph_neighbors_count(comm, &indegree, &nb_neighbors, &weighted);
+    }
+    long long bytes = 0;
+    for (int n = 0; n < nb_neighbors; n++)
+    {
+        bytes += trace_bytes(sendcounts[n], sendtypes[n]);
+    }
+    trace_record(TRACE_NEIGHBOR_ALLTOALLW, start, bytes, -1);
+    return result;
+}
+
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+    trace_record(TRACE_ALLREDUCE, start, trace_bytes(count, datatype), -1);
+    return result;
+}
+
+
+int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm, MPI_Request *request)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, comm, request);
+    trace_record(TRACE_IALLREDUCE, start, trace_bytes(count, datatype), -1);
+    return result;
+}
+
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+    trace_record(TRACE_REDUCE, start, trace_bytes(count, datatype), root);
+    return result;
+}
+
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Bcast(buffer, count, datatype, root, comm);
+    trace_record(TRACE_BCAST, start, trace_bytes(count, datatype), root);
+    return result;
+}
+
+
+int MPI_Barrier(MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Barrier(comm);
+    trace_record(TRACE_BARRIER, start, 0, -1);
+    return result;
+}